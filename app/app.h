@@ -1,14 +1,25 @@
 #ifndef APP_APP_H
 #define APP_APP_H
 
+#include <array>
 #include <cstdarg>
+#include <utility>
 
+#include "app/flow.h"
+#include "app/history.h"
 #include "app/indicator.h"
+#include "app/protocol.h"
+#include "app/sequencer.h"
+#include "app/telemetry.h"
 #include "app/valve.h"
 #include "app_config.h"
 #include "io/app_api.h"
-#include "io/conversion.h"
+#include "io/channels.h"
+#include "io/frame.h"
 #include "io/freq.h"
+#include "io/gpio.h"
+#include "io/link.h"
+#include "io/scheduler.h"
 
 class Framework;
 
@@ -24,19 +35,110 @@ class App : public AppApi {
   auto write_buffer() -> std::pair<const char*, size_t> override;
   auto write_done(size_t length) -> void override;
 
+  // Settings by protocol key, changes are applied and kept in flash.
+  auto configure(uint8_t key, uint32_t value) -> bool;
+  auto setting(uint8_t key, uint32_t& value) -> bool;
+
  private:
+  template <size_t index>
+  using ValveChannel = Valve<VALVES[index].pin>;
+  template <size_t... I>
+  static auto valve_outputs(std::index_sequence<I...>)
+      -> GpioGroup<GpioOutput{VALVES[I].pin, VALVES[I].active_high}...>;
+  using ValveOutputs =
+      decltype(valve_outputs(std::make_index_sequence<NUM_VALVES>{}));
+  template <size_t index>
+  using SensorChannel = Freq<SENSORS[index].pin, SENSORS[index].window_ms>;
+
+  // One task per valve, valve flow and sensor, from VALVE, FLOW and SENSOR.
+  enum Task : Scheduler::Id {
+    VALVE = 0,
+    FLOW = VALVE + NUM_VALVES,
+    SENSOR = FLOW + NUM_VALVES,
+    TELEMETRY = SENSOR + NUM_SENSORS,
+    SEQUENCER,
+    LINK,
+    TIMEOUT,
+    WATCHDOG,
+    HEARTBEAT,
+    NUM_TASKS
+  };
+  static_assert(NUM_TASKS <= Scheduler::MAX_TASKS);
+
   auto perform_command() -> void;
+  auto perform_frame(protocol::Type type, const uint8_t* payload,
+                     size_t length) -> void;
+  auto perform_batch() -> void;
+  auto perform_batch_frame() -> void;
+  auto perform_forward(const uint8_t* payload, size_t length) -> void;
+  auto perform_forwarded(const protocol::Forward& header,
+                         const uint8_t* payload, size_t length,
+                         bool to_link) -> void;
+  auto perform_link_frame(protocol::Type type, const uint8_t* payload,
+                          size_t length) -> void;
+  auto send_link(protocol::Type type, const void* payload,
+                 size_t length) -> bool;
+  auto service_link(uint64_t now) -> void;
+  auto linked() const -> bool {
+    return address_ != protocol::LINK_BROADCAST;
+  }
   auto parse(char c) -> void;
+  auto pulse(uint8_t target, unsigned duration_sec, uint64_t now) -> bool;
+  auto meter(uint8_t target, uint32_t volume_ml, unsigned max_sec) -> bool;
+  auto supervise(uint8_t valve, uint64_t now, bool clear = false) -> void;
+  auto heard(uint64_t now) -> void;
+  auto trip(protocol::Failsafe reason, uint64_t due) -> void;
+  auto clear_failsafe() -> void;
+  auto latched() const -> bool {
+    return failsafe_.latched != protocol::Failsafe::NONE;
+  }
+  auto faults() -> uint16_t;
+  auto refresh_status() -> void;
+  auto send_status() -> void;
+  auto sample(uint8_t sensor) -> protocol::Sample;
+  auto reading(uint8_t sensor, uint32_t &sequence) -> protocol::Reading;
+  auto subscribe(uint8_t sensor, uint32_t interval_ms, uint8_t batch) -> bool;
+  auto stream(uint64_t now) -> void;
+  auto load() -> void;
+  auto program(uint8_t index, const Sequencer::Step& step) -> bool;
+  auto run(protocol::Run action) -> bool;
+  auto sequence(uint64_t now) -> void;
+  auto record(uint8_t sensor) -> void;
+  auto update_valves() -> void;
+  auto valves_on() -> uint16_t;
+  auto staying_on(uint64_t now) -> bool;
+  auto send_history(uint32_t from) -> void;
 
   Framework& framework_;
   Indicator<LED_RED_PIN, LED_GRN_PIN, LED_BLU_PIN> indicator_;
-  Valve<VALVE0_PIN, VALVE0_ON> valve0_;
-  Valve<VALVE1_PIN, VALVE1_ON> valve1_;
-  Freq<MOISTURE0_PIN, 10> moisture0_;
-  Freq<MOISTURE1_PIN, 10> moisture1_;
-  Freq<FLOW0_PIN, 2> flow0_;
-  Freq<FLOW1_PIN, 2> flow1_;
+  ChannelsOf<ValveChannel, NUM_VALVES> valves_;
+  ValveOutputs valve_outputs_;
+  ChannelsOf<SensorChannel, NUM_SENSORS> sensors_;
+  std::array<Flow, NUM_VALVES> flows_;
+  // Flow pulses per litre, per valve.
+  std::array<uint32_t, NUM_VALVES> calibration_;
+  Telemetry telemetry_;
+  Sequencer sequencer_;
+  History<HISTORY_CAPACITY> history_;
+  // Valve states as last written and recorded in history, bit per valve.
+  uint16_t recorded_valves_;
+  // Sensor values last recorded in history.
+  std::array<uint32_t, protocol::NUM_SENSORS> recorded_;
+  // Sequence of the last reading shown by status or a sample, per sensor.
+  std::array<uint32_t, protocol::NUM_SENSORS> seen_;
+  // The same for the s reply alone.
+  std::array<uint32_t, protocol::NUM_SENSORS> polled_;
   uint64_t timeout_;
+  // Heartbeat timeout, 0 for none, and when it's next due.
+  uint32_t heartbeat_ms_;
+  uint64_t heartbeat_due_;
+  protocol::FailsafeState failsafe_;
+  protocol::Mode mode_;
+  Frame frame_;
+  Link link_;
+  Frame link_frame_;
+  // On the link, LINK_BROADCAST when it isn't used.
+  uint8_t address_;
 };
 
 #endif  // APP_APP_H
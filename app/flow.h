@@ -0,0 +1,125 @@
+#ifndef APP_FLOW_H
+#define APP_FLOW_H
+
+#include <cstdint>
+
+#include "app/protocol.h"
+
+// Flow meter supervision of one valve.
+// While metering, the valve is closed once the flow sensor has counted the
+// target number of pulses. Checks are timed from the measured rate, halving
+// the time left each time, so the valve closes within a millisecond or so of
+// the target without polling at that rate for the whole delivery. Whenever
+// the valve is open and no pulses arrive for NO_FLOW_US the valve is stuck
+// or the supply is off, which closes it only while metering as a timed
+// opening may have no meter fitted or a slow supply. Once closed and
+// SETTLE_US has let the line drain, more than LEAK_PULSES in a
+// LEAK_WINDOW_US means it is leaking.
+class Flow {
+ public:
+  static constexpr uint64_t NO_FLOW_US = 5 * 1000 * 1000;
+  static constexpr uint64_t SETTLE_US = 10 * 1000 * 1000;
+  static constexpr uint64_t LEAK_WINDOW_US = 60 * 1000 * 1000;
+  static constexpr uint32_t LEAK_PULSES = 20;
+  static constexpr uint64_t MIN_CHECK_US = 1000;
+  static constexpr uint64_t MAX_CHECK_US = 100 * 1000;
+
+  using Fault = protocol::Fault;
+
+  Flow()
+      : open_{false},
+        metering_{false},
+        settling_{false},
+        fault_{Fault::NONE},
+        target_{0},
+        count_{0},
+        since_{0},
+        next_{0} {}
+
+  // Close the valve after pulses more, from the next update() seeing it open.
+  auto meter(uint32_t count, uint32_t pulses) -> void {
+    metering_ = true;
+    target_ = count + pulses;
+  }
+
+  auto clear() -> void {
+    metering_ = false;
+    fault_ = Fault::NONE;
+  }
+
+  // Track the valve and the total count, rate is the last frequency in
+  // millihertz. True when the valve should be closed now.
+  auto update(bool open, uint32_t count, uint32_t rate_mhz,
+              uint64_t now) -> bool {
+    if (open != open_) {
+      open_ = open;
+      count_ = count;
+      since_ = now;
+      settling_ = !open;
+      if (!open) metering_ = false;
+    }
+    bool close = false;
+    if (open) {
+      if (count != count_) {
+        count_ = count;
+        since_ = now;
+      } else if (now - since_ >= NO_FLOW_US) {
+        fault_ = Fault::NO_FLOW;
+        close = metering_;
+        // Left open, checked again a NO_FLOW_US on.
+        since_ = now;
+      }
+      if (metering_ && static_cast<int32_t>(count - target_) >= 0) {
+        metering_ = false;
+        close = true;
+      }
+      next_ = since_ + NO_FLOW_US;
+      if (metering_) {
+        auto check = now + until(target_ - count, rate_mhz);
+        if (check < next_) next_ = check;
+      }
+    } else if (settling_) {
+      // Pulses from the line draining aren't a leak.
+      count_ = count;
+      if (now - since_ >= SETTLE_US) {
+        settling_ = false;
+        since_ = now;
+        next_ = since_ + LEAK_WINDOW_US;
+      } else {
+        next_ = since_ + SETTLE_US;
+      }
+    } else {
+      if (count - count_ > LEAK_PULSES) fault_ = Fault::LEAK;
+      if (now - since_ >= LEAK_WINDOW_US) {
+        count_ = count;
+        since_ = now;
+      }
+      next_ = since_ + LEAK_WINDOW_US;
+    }
+    return close;
+  }
+
+  auto deadline() const -> uint64_t { return next_; }
+  auto fault() const -> Fault { return fault_; }
+  auto metering() const -> bool { return metering_; }
+
+ private:
+  // Half the time the remaining pulses are expected to take.
+  static auto until(uint32_t remaining, uint32_t rate_mhz) -> uint64_t {
+    if (rate_mhz == 0) return MAX_CHECK_US;
+    auto us = (remaining * 1000ULL * 1000ULL * 1000ULL) / rate_mhz / 2;
+    if (us < MIN_CHECK_US) return MIN_CHECK_US;
+    return (us > MAX_CHECK_US) ? MAX_CHECK_US : us;
+  }
+
+  bool open_;
+  bool metering_;
+  bool settling_;
+  Fault fault_;
+  uint32_t target_;
+  uint32_t count_;
+  uint64_t since_;
+  uint64_t next_;
+};
+
+#endif  // APP_FLOW_H
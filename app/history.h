@@ -0,0 +1,129 @@
+#ifndef APP_HISTORY_H
+#define APP_HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Fixed capacity history of readings and events, oldest overwritten first.
+// Kept as a structure of arrays with timestamps as 16 bit millisecond deltas
+// from the record before, 7 bytes a record. Longer silences are bridged by a
+// GAP slot holding the whole delta. Every real record gets the next sequence
+// number so a host can ask for everything since the last one it saw.
+template <size_t capacity>
+class History {
+  static_assert((capacity & (capacity - 1)) == 0,
+                "History capacity must be a power of 2");
+  static constexpr uint8_t GAP = 0xff;
+  static constexpr uint32_t MAX_DELTA = 0xffff;
+
+ public:
+  struct Record {
+    uint32_t sequence;
+    uint32_t time_ms;
+    uint32_t value;
+    uint8_t source;
+  };
+
+  History()
+      : tail_{0},
+        size_{0},
+        records_{0},
+        oldest_sequence_{0},
+        oldest_time_ms_{0},
+        last_time_ms_{0} {}
+
+  // Times are clamped so they never go backwards.
+  auto append(uint8_t source, uint32_t value, uint32_t time_ms) -> void {
+    if (size_ == 0) {
+      oldest_time_ms_ = time_ms;
+      last_time_ms_ = time_ms;
+    }
+    auto delta = static_cast<int32_t>(time_ms - last_time_ms_);
+    if (delta < 0) delta = 0;
+    last_time_ms_ += delta;
+    if (static_cast<uint32_t>(delta) > MAX_DELTA) {
+      push(GAP, 0, static_cast<uint32_t>(delta));
+      delta = 0;
+    }
+    push(source, static_cast<uint16_t>(delta), value);
+  }
+
+  auto next_sequence() const -> uint32_t {
+    return oldest_sequence_ + records_;
+  }
+
+  // Where a read got to, slots from the oldest with the sequence and time
+  // there, so the next read carries on without decoding from the start
+  // again. Only good until the next append.
+  struct Cursor {
+    size_t slot;
+    uint32_t sequence;
+    uint32_t time_ms;
+  };
+
+  auto begin() const -> Cursor {
+    return Cursor{0, oldest_sequence_, oldest_time_ms_};
+  }
+
+  // Visit records from sequence on, oldest first, until visit returns false
+  // for one, which the cursor is then left at. Anything older than the
+  // history holds is skipped.
+  template <typename Visit>
+  auto read(uint32_t from, Cursor &cursor, Visit visit) const -> void {
+    while (cursor.slot < size_) {
+      auto slot = (tail_ + cursor.slot) & (capacity - 1);
+      if (source_[slot] != GAP) {
+        if (static_cast<int32_t>(cursor.sequence - from) >= 0 &&
+            !visit(Record{cursor.sequence, cursor.time_ms, value_[slot],
+                          source_[slot]}))
+          return;
+        ++cursor.sequence;
+      }
+      if (++cursor.slot < size_)
+        cursor.time_ms += step((slot + 1) & (capacity - 1));
+    }
+  }
+
+  template <typename Visit>
+  auto read(uint32_t from, Visit visit) const -> void {
+    auto cursor = begin();
+    read(from, cursor, visit);
+  }
+
+ private:
+  auto step(size_t slot) const -> uint32_t {
+    return (source_[slot] == GAP) ? value_[slot] : delta_ms_[slot];
+  }
+
+  auto push(uint8_t source, uint16_t delta_ms, uint32_t value) -> void {
+    if (size_ == capacity) evict();
+    auto slot = (tail_ + size_) & (capacity - 1);
+    delta_ms_[slot] = delta_ms;
+    source_[slot] = source;
+    value_[slot] = value;
+    if (source != GAP) ++records_;
+    ++size_;
+  }
+
+  auto evict() -> void {
+    if (source_[tail_] != GAP) {
+      ++oldest_sequence_;
+      --records_;
+    }
+    tail_ = (tail_ + 1) & (capacity - 1);
+    --size_;
+    if (size_ != 0) oldest_time_ms_ += step(tail_);
+  }
+
+  uint16_t delta_ms_[capacity];
+  uint8_t source_[capacity];
+  uint32_t value_[capacity];
+  size_t tail_;
+  size_t size_;
+  size_t records_;
+  uint32_t oldest_sequence_;
+  uint32_t oldest_time_ms_;
+  uint32_t last_time_ms_;
+};
+
+#endif  // APP_HISTORY_H
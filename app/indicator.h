@@ -1,6 +1,11 @@
 #ifndef APP_INDICATOR_H
 #define APP_INDICATOR_H
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
 #include "pico/time.h"
@@ -10,60 +15,97 @@ enum class State {
   CONNECTED,
   VALVE0_ON,
   VALVE1_ON,
-  BOTH_VALVES_ON
+  BOTH_VALVES_ON,
+  FAILSAFE
 };
 
+// RGB status led.
+// Each state is a constexpr pattern of timed colour steps, played from a
+// repeating timer alarm so the main loop only calls set_state() and the
+// pattern keeps time however busy or asleep the core is. The connected
+// pattern fades, each lit step dimmer down to MIN_FADE, with the compare
+// levels for every fade taken from a constexpr table.
 template <uint red_pin, uint grn_pin, uint blu_pin>
 class Indicator {
   static constexpr uint FADE = 60;
   static constexpr uint MIN_FADE = 6;
-  static constexpr uint MAX_PHASE = 7;
   static constexpr uint16_t PWM_WRAP = 254;
+  static constexpr uint16_t OFF = PWM_WRAP + 1;
   static constexpr uint RED_LEVEL = 64;
   static constexpr uint GRN_LEVEL = 64;
   static constexpr uint BLU_LEVEL = 192;
 
+  // Colour bits.
+  static constexpr uint8_t DARK = 0;
+  static constexpr uint8_t RED = 1;
+  static constexpr uint8_t GRN = 2;
+  static constexpr uint8_t BLU = 4;
+
+  struct Step {
+    uint16_t ms;
+    uint8_t colour;
+  };
+
+  struct Pattern {
+    const Step *steps;
+    uint8_t size;
+    bool fades;
+  };
+
+  static constexpr Step DISCONNECTED_STEPS[] = {{250, DARK}, {750, RED}};
+  static constexpr Step CONNECTED_STEPS[] = {
+      {750, DARK}, {250, RED}, {750, DARK}, {250, GRN},
+      {750, DARK}, {250, BLU}, {750, DARK}, {250, DARK}};
+  static constexpr Step VALVE0_STEPS[] = {{500, DARK}, {500, GRN}};
+  static constexpr Step VALVE1_STEPS[] = {{500, DARK}, {500, BLU}};
+  static constexpr Step BOTH_VALVES_STEPS[] = {{500, BLU}, {500, GRN}};
+  static constexpr Step FAILSAFE_STEPS[] = {{100, DARK}, {100, RED}};
+
+  // By State.
+  static constexpr Pattern PATTERNS[] = {
+      {DISCONNECTED_STEPS, std::size(DISCONNECTED_STEPS), false},
+      {CONNECTED_STEPS, std::size(CONNECTED_STEPS), true},
+      {VALVE0_STEPS, std::size(VALVE0_STEPS), false},
+      {VALVE1_STEPS, std::size(VALVE1_STEPS), false},
+      {BOTH_VALVES_STEPS, std::size(BOTH_VALVES_STEPS), false},
+      {FAILSAFE_STEPS, std::size(FAILSAFE_STEPS), false}};
+
+  // Compare levels of red, green and blue, by fade. The pwm output is
+  // inverted, a higher level is dimmer.
+  using Levels = std::array<uint16_t, 3>;
+  static constexpr auto LEVELS = [] {
+    std::array<Levels, FADE + 1> table{};
+    const uint on[] = {RED_LEVEL, GRN_LEVEL, BLU_LEVEL};
+    for (uint fade = 0; fade <= FADE; ++fade) {
+      for (size_t colour = 0; colour < 3; ++colour)
+        table[fade][colour] =
+            static_cast<uint16_t>(PWM_WRAP - (on[colour] * fade) / FADE);
+    }
+    return table;
+  }();
+
  public:
   Indicator()
-      : state_{State::DISCONNECTED},
-        phase_{0},
-        next_{0},
-        on_duration_ms_{750},
-        off_duration_ms_{250},
-        fade_{0} {}
+      : state_{State::DISCONNECTED}, index_{0}, fade_{FADE}, alarm_{0} {}
   constexpr auto get_red_pin() { return red_pin; }
   constexpr auto get_grn_pin() { return grn_pin; }
   constexpr auto get_blu_pin() { return blu_pin; }
 
+  // Restarts the pattern, at full brightness, when the state changes.
   auto set_state(State state) {
-    if (state != state_) {
-      state_ = state;
-      switch (state_) {
-        case State::DISCONNECTED:
-          on_duration_ms_ = 750;
-          off_duration_ms_ = 250;
-          break;
-        case State::CONNECTED:
-          on_duration_ms_ = 250;
-          off_duration_ms_ = 750;
-          break;
-        case State::VALVE0_ON:
-        case State::VALVE1_ON:
-        case State::BOTH_VALVES_ON:
-          on_duration_ms_ = 500;
-          off_duration_ms_ = 500;
-          break;
-      }
-      fade_ = FADE;
-    }
+    if (state == state_) return;
+    // Once cancelled the alarm callback can't be running, so the pattern
+    // can be changed without masking interrupts.
+    if (alarm_ > 0) cancel_alarm(alarm_);
+    state_ = state;
+    index_ = 0;
+    fade_ = FADE;
+    start();
   }
 
   auto get_state() { return static_cast<uint8_t>(state_); }
 
   auto init(bool on) {
-    set_state(State::DISCONNECTED);
-    fade_ = FADE;
-
     // Initialise pwm.
     gpio_set_function(red_pin, GPIO_FUNC_PWM);
     gpio_set_function(grn_pin, GPIO_FUNC_PWM);
@@ -85,110 +127,76 @@ class Indicator {
       pwm_set_enabled(blu_slice, true);
     }
 
-    pwm_set_gpio_level(red_pin, off_level(RED_LEVEL));
-    pwm_set_gpio_level(grn_pin, off_level(GRN_LEVEL));
-    pwm_set_gpio_level(blu_pin, off_level(BLU_LEVEL));
+    show(OFF, OFF, OFF);
+    state_ = State::DISCONNECTED;
+    index_ = 0;
+    fade_ = FADE;
+    start();
+  }
+
+ private:
+  auto start() -> void {
+    alarm_ = add_alarm_in_us(0, alarm_callback, this, true);
+  }
+
+  // A negative return repeats the alarm that long after it was due, so the
+  // pattern doesn't drift by the interrupt latency.
+  static auto alarm_callback(alarm_id_t, void *data) -> int64_t {
+    return -static_cast<Indicator *>(data)->step();
+  }
+
+  // Show the current step, returning how long for in us.
+  auto step() -> int64_t {
+    const auto &pattern = PATTERNS[static_cast<size_t>(state_)];
+    const auto &step = pattern.steps[index_];
+    const auto &levels = LEVELS[fade_];
+    show((step.colour & RED) ? levels[0] : OFF,
+         (step.colour & GRN) ? levels[1] : OFF,
+         (step.colour & BLU) ? levels[2] : OFF);
+    if (pattern.fades && step.colour != DARK && fade_ > MIN_FADE) fade_ -= 1;
+    index_ = (index_ + 1 < pattern.size) ? index_ + 1 : 0;
+    return static_cast<int64_t>(step.ms) * 1000;
   }
 
-  auto periodic() {
-    auto now = time_us_64();
-    if (next_ < now) {
-      if ((phase_ & 1) == 0) {
-        set(false);
-        if (off_duration_ms_ != 0) {
-          next_ = (static_cast<uint64_t>(off_duration_ms_) * 1000UL) + now;
-        } else {
-          next_ = 0;
-        }
+  // Pins sharing a slice are written with one store to its compare register,
+  // which takes effect at the next wrap, so a colour change never shows a
+  // mix of the old and new levels for a period.
+  auto show(uint16_t red, uint16_t grn, uint16_t blu) {
+    constexpr uint pins[] = {red_pin, grn_pin, blu_pin};
+    const uint16_t levels[] = {red, grn, blu};
+    for (size_t i = 0; i < 3; ++i) {
+      auto other = partner(pins, i);
+      if (other < i) continue;
+      auto slice = slice_of(pins[i]);
+      if (other == NO_PARTNER) {
+        pwm_set_chan_level(slice, pins[i] & 1u, levels[i]);
+      } else if ((pins[i] & 1u) == PWM_CHAN_A) {
+        pwm_set_both_levels(slice, levels[i], levels[other]);
       } else {
-        if (on_duration_ms_ != 0) {
-          set(true);
-          next_ = (static_cast<uint64_t>(on_duration_ms_) * 1000UL) + now;
-        } else {
-          next_ = 0;
-        }
+        pwm_set_both_levels(slice, levels[other], levels[i]);
       }
-      if (phase_ < MAX_PHASE)
-        phase_ += 1;
-      else
-        phase_ = 0;
     }
   }
 
- private:
-  auto set(bool on) {
-    if (on) {
-      switch (state_) {
-        case State::DISCONNECTED:
-          pwm_set_gpio_level(red_pin, on_level(RED_LEVEL));
-          pwm_set_gpio_level(grn_pin, off_level(GRN_LEVEL));
-          pwm_set_gpio_level(blu_pin, off_level(BLU_LEVEL));
-          break;
-        case State::CONNECTED:
-          switch (phase_) {
-            case 1:
-              pwm_set_gpio_level(red_pin, on_level(RED_LEVEL));
-              pwm_set_gpio_level(grn_pin, off_level(GRN_LEVEL));
-              pwm_set_gpio_level(blu_pin, off_level(BLU_LEVEL));
-              break;
-            case 3:
-              pwm_set_gpio_level(red_pin, off_level(RED_LEVEL));
-              pwm_set_gpio_level(grn_pin, on_level(GRN_LEVEL));
-              pwm_set_gpio_level(blu_pin, off_level(BLU_LEVEL));
-              break;
-            case 5:
-              pwm_set_gpio_level(red_pin, off_level(RED_LEVEL));
-              pwm_set_gpio_level(grn_pin, off_level(GRN_LEVEL));
-              pwm_set_gpio_level(blu_pin, on_level(BLU_LEVEL));
-              break;
-            default:
-              pwm_set_gpio_level(red_pin, off_level(RED_LEVEL));
-              pwm_set_gpio_level(grn_pin, off_level(GRN_LEVEL));
-              pwm_set_gpio_level(blu_pin, off_level(BLU_LEVEL));
-              break;
-          }
-          if (fade_ > MIN_FADE) fade_ -= 1;
-          break;
-        case State::VALVE1_ON:
-          pwm_set_gpio_level(red_pin, off_level(RED_LEVEL));
-          pwm_set_gpio_level(grn_pin, off_level(GRN_LEVEL));
-          pwm_set_gpio_level(blu_pin, on_level(BLU_LEVEL));
-          break;
-        case State::VALVE0_ON:
-        case State::BOTH_VALVES_ON:
-          pwm_set_gpio_level(red_pin, off_level(RED_LEVEL));
-          pwm_set_gpio_level(grn_pin, on_level(GRN_LEVEL));
-          pwm_set_gpio_level(blu_pin, off_level(BLU_LEVEL));
-          break;
-      }
-    } else {
-      switch (state_) {
-        case State::DISCONNECTED:
-        case State::CONNECTED:
-        case State::VALVE0_ON:
-        case State::VALVE1_ON:
-          pwm_set_gpio_level(red_pin, off_level(RED_LEVEL));
-          pwm_set_gpio_level(grn_pin, off_level(GRN_LEVEL));
-          pwm_set_gpio_level(blu_pin, off_level(BLU_LEVEL));
-          break;
-        case State::BOTH_VALVES_ON:
-          pwm_set_gpio_level(red_pin, off_level(RED_LEVEL));
-          pwm_set_gpio_level(grn_pin, off_level(GRN_LEVEL));
-          pwm_set_gpio_level(blu_pin, on_level(BLU_LEVEL));
-          break;
-      }
+  // As pwm_gpio_to_slice_num() for bank 0.
+  static constexpr auto slice_of(uint pin) -> uint { return (pin >> 1u) & 7u; }
+  // Index of the other pin on the same slice, or NO_PARTNER.
+  static constexpr size_t NO_PARTNER = 3;
+  static constexpr auto partner(const uint (&pins)[3], size_t i) -> size_t {
+    for (size_t j = 0; j < 3; ++j) {
+      if (j != i && slice_of(pins[j]) == slice_of(pins[i])) return j;
     }
+    return NO_PARTNER;
   }
-
-  auto on_level(uint on) -> uint16_t { return PWM_WRAP - (on * fade_) / FADE; }
-  auto off_level(uint off) -> uint16_t { return PWM_WRAP + 1; }
+  static_assert(red_pin < 32 && grn_pin < 32 && blu_pin < 32);
+  static_assert(red_pin != grn_pin && red_pin != blu_pin && grn_pin != blu_pin);
+  static_assert(std::size(PATTERNS) ==
+                static_cast<size_t>(State::FAILSAFE) + 1);
 
   State state_;
-  uint phase_;
-  uint64_t next_;
-  unsigned on_duration_ms_;
-  unsigned off_duration_ms_;
+  uint8_t index_;
   uint fade_;
+  alarm_id_t alarm_;
 };
 
 #endif  // APP_INDICATOR_H
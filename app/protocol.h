@@ -0,0 +1,284 @@
+#ifndef APP_PROTOCOL_H
+#define APP_PROTOCOL_H
+
+#include <cstdint>
+
+#include "app_config.h"
+
+// Binary api protocol, carried in io/frame.h frames once the text command
+// 'm1' has switched the api channel over. All fields are little endian.
+namespace protocol {
+
+enum class Mode : uint8_t { TEXT = 0, BINARY = 1 };
+
+enum class Type : uint8_t {
+  // Requests.
+  STATUS = 0x01,
+  VALVE = 0x02,
+  RESET = 0x03,
+  MODE = 0x04,
+  SAMPLE = 0x05,
+  TELEMETRY = 0x06,
+  HISTORY = 0x07,
+  BATCH = 0x08,
+  PROGRAM = 0x09,
+  RUN = 0x0a,
+  VOLUME = 0x0b,
+  CONFIG = 0x0c,
+  STATS = 0x0d,
+  FORWARD = 0x0e,
+  STATUS_SINCE = 0x0f,
+  HEARTBEAT = 0x10,
+  // Responses have the top bit set.
+  STATUS_REPLY = 0x81,
+  ACK = 0x82,
+  NAK = 0x83,
+  SAMPLE_REPLY = 0x85,
+  // Pushed without a request, one or more Readings.
+  TELEMETRY_DATA = 0x86,
+  HISTORY_DATA = 0x87,
+  BATCH_REPLY = 0x88,
+  CONFIG_REPLY = 0x8c,
+  STATS_REPLY = 0x8d,
+  FORWARD_REPLY = 0x8e,
+  STATUS_SINCE_REPLY = 0x8f
+};
+
+enum class Error : uint8_t {
+  NONE = 0,
+  UNKNOWN_TYPE,
+  BAD_LENGTH,
+  BAD_TARGET,
+  BAD_VALUE,
+  BUSY
+};
+
+// Sensors and valves are numbered by their order in app_config.h.
+constexpr uint8_t NUM_SENSORS = ::NUM_SENSORS;
+constexpr uint8_t NUM_VALVES = ::NUM_VALVES;
+
+// Sample flags.
+constexpr uint8_t SAMPLE_UPDATED = 0x01;
+
+struct __attribute__((packed)) ValveRequest {
+  uint8_t target;
+  uint16_t duration_sec;
+};
+
+struct __attribute__((packed)) ResetRequest {
+  uint16_t value;
+};
+
+struct __attribute__((packed)) ModeRequest {
+  Mode mode;
+};
+
+struct __attribute__((packed)) SampleRequest {
+  uint8_t sensor;
+};
+
+struct __attribute__((packed)) Sample {
+  uint32_t value;  // Millihertz.
+  uint8_t sensor;
+  uint8_t flags;
+};
+
+// Subscribe to a sensor, an interval of zero unsubscribes. Batch is the
+// number of readings sent together, shared by all subscriptions.
+struct __attribute__((packed)) TelemetryRequest {
+  uint8_t sensor;
+  uint16_t interval_ms;
+  uint8_t batch;
+};
+
+struct __attribute__((packed)) Reading {
+  uint32_t time_ms;  // End of the measurement window since boot.
+  uint32_t value;    // Millihertz.
+  uint16_t sequence;
+  uint8_t sensor;
+};
+
+// History record sources other than sensors, which use their sensor number.
+// Valve records are SOURCE_VALVE plus the valve number with a value of 1 for
+// on and 0 for off.
+constexpr uint8_t SOURCE_VALVE = 0x10;
+// Flow faults of a valve are SOURCE_FLOW plus the valve number with a value
+// of the Fault, 0 when cleared.
+constexpr uint8_t SOURCE_FLOW = 0x20;
+
+enum class Fault : uint8_t { NONE = 0, NO_FLOW, LEAK };
+
+// Failsafe trips are SOURCE_FAILSAFE plus the Failsafe with a value of the
+// shutoff latency in us, 0 if not known, and clearing it is SOURCE_FAILSAFE
+// with 0.
+constexpr uint8_t SOURCE_FAILSAFE = 0x30;
+
+// A latched failsafe closes every valve and keeps them closed until cleared.
+// HEARTBEAT trips when KEY_HEARTBEAT is set and no request has been seen for
+// that long, WATCHDOG when the main loop stalled and the hardware watchdog
+// reset the unit.
+enum class Failsafe : uint8_t { NONE = 0, HEARTBEAT, WATCHDOG };
+
+// Open a valve until its flow sensor has counted volume_ml, or for at most
+// max_sec, zero for the default.
+struct __attribute__((packed)) VolumeRequest {
+  uint8_t target;
+  uint32_t volume_ml;
+  uint16_t max_sec;
+};
+
+struct __attribute__((packed)) HistoryRequest {
+  uint32_t sequence;
+};
+
+// HISTORY_DATA is a HistoryHeader then Records with consecutive sequence
+// numbers from first. No records means the host is up to date.
+struct __attribute__((packed)) HistoryHeader {
+  uint32_t first;
+};
+
+struct __attribute__((packed)) Record {
+  uint32_t time_ms;
+  uint32_t value;
+  uint8_t source;
+};
+
+// One step of the valve program, see app/sequencer.h.
+struct __attribute__((packed)) ProgramRequest {
+  uint8_t step;
+  uint8_t valve;
+  uint16_t offset_sec;
+  uint16_t duration_sec;
+  uint8_t after;  // Step this one follows, 0xff for none.
+};
+
+enum class Run : uint8_t { STOP = 0, START, START_EXCLUSIVE, CLEAR };
+
+struct __attribute__((packed)) RunRequest {
+  Run action;
+};
+
+// Settings kept in flash, a key base plus the sensor, valve or step number.
+constexpr uint8_t KEY_WINDOW = 0x00;       // Sensor window in ms.
+constexpr uint8_t KEY_CALIBRATION = 0x10;  // Valve flow pulses per litre.
+constexpr uint8_t KEY_STEP = 0x20;         // Program step, a ProgramRequest.
+constexpr uint8_t KEY_LINK = 0x30;         // Link address, see Forward.
+constexpr uint8_t KEY_HEARTBEAT = 0x31;    // Heartbeat timeout in ms, 0 off.
+// The latched Failsafe, set to 0 to clear it. Kept as a FailsafeState.
+constexpr uint8_t KEY_FAILSAFE = 0x32;
+
+struct __attribute__((packed)) FailsafeState {
+  Failsafe latched;
+  uint32_t trips;           // Since the store was erased.
+  uint32_t max_latency_us;  // Worst heartbeat shutoff, deadline to outputs.
+};
+
+// Any request is a heartbeat, HEARTBEAT is one that does nothing else or
+// clears a latched failsafe. The ACK's target is the Failsafe still latched.
+struct __attribute__((packed)) HeartbeatRequest {
+  uint8_t clear;
+};
+
+// Set a setting, or with only the key read it back as a CONFIG_REPLY.
+// Program steps are kept by PROGRAM rather than set here.
+struct __attribute__((packed)) ConfigRequest {
+  uint8_t key;
+  uint32_t value;
+};
+
+struct __attribute__((packed)) ConfigReply {
+  uint8_t key;
+  uint32_t value;
+};
+
+// Main loop counters, see io/stats.h. Channels are the api then the console.
+struct __attribute__((packed)) StatsReply {
+  uint32_t passes;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint32_t histogram[16];
+  uint32_t time_ms[4];  // USB, console, api then app.
+  uint32_t in[2];
+  uint32_t out[2];
+  uint32_t high_water[2];
+  uint32_t dropped[2];
+};
+
+// Expansion units are wired in a ring over their uart link, each one's tx to
+// the next one's rx and the last back to the head, the unit the host talks
+// to. Each has a link address set with KEY_LINK, the head 0. FORWARD is a
+// Forward header then the payload of a request for the unit at address, or
+// for every unit at LINK_BROADCAST. Frames go round the ring until they
+// reach their unit and replies carry on round to the head, each one coming
+// back to the host as a FORWARD_REPLY of the replying unit's address and
+// the reply type then its payload. Replies are all there is, FORWARD isn't
+// acked and telemetry isn't carried.
+constexpr uint8_t LINK_BROADCAST = 0xff;
+// Hops over which a frame is dropped, in case there is no head to stop it.
+constexpr uint8_t LINK_MAX_HOPS = 32;
+
+struct __attribute__((packed)) Forward {
+  uint8_t address;
+  uint8_t hops;
+  Type type;
+};
+
+// BATCH and BATCH_REPLY payloads are a run of Entry headers each followed by
+// length bytes of the request or reply payload of that type. Only STATUS,
+// SAMPLE, VALVE, VOLUME, TELEMETRY and PROGRAM can be batched.
+struct __attribute__((packed)) Entry {
+  Type type;
+  uint8_t length;
+};
+
+// 6 bytes plus 6 per sensor. With the frame's 5, a STATUS_REPLY for four
+// sensors is 35 bytes on the wire.
+struct __attribute__((packed)) Status {
+  uint8_t indicator;
+  uint16_t valves;  // Bit per valve, set when on.
+  uint16_t faults;  // Bit per valve, set while it has a flow fault.
+  uint8_t sensors;
+  Sample samples[NUM_SENSORS];
+};
+
+// The status is numbered by generation, one more each time something in it
+// changes. STATUS_SINCE's reply is empty while the status is still the
+// given generation, otherwise a Snapshot. A generation of 0 is never used.
+struct __attribute__((packed)) StatusSince {
+  uint32_t generation;
+};
+
+struct __attribute__((packed)) Snapshot {
+  uint32_t generation;
+  Status status;
+};
+
+struct __attribute__((packed)) Ack {
+  Type request;
+  uint8_t target;
+};
+
+struct __attribute__((packed)) Nak {
+  Type request;
+  Error error;
+};
+
+static_assert(sizeof(ValveRequest) == 3);
+static_assert(sizeof(Sample) == 6);
+static_assert(sizeof(TelemetryRequest) == 4);
+static_assert(sizeof(Reading) == 11);
+static_assert(sizeof(Record) == 9);
+static_assert(sizeof(ProgramRequest) == 7);
+static_assert(sizeof(VolumeRequest) == 7);
+static_assert(sizeof(ConfigRequest) == 5);
+static_assert(sizeof(StatsReply) == 124);
+static_assert(sizeof(Forward) == 3);
+static_assert(sizeof(Status) == 6 + (6 * NUM_SENSORS));
+static_assert(sizeof(StatusSince) == 4);
+static_assert(sizeof(FailsafeState) == 9);
+static_assert(sizeof(HeartbeatRequest) == 1);
+static_assert(sizeof(Snapshot) == 4 + sizeof(Status));
+
+}  // namespace protocol
+
+#endif  // APP_PROTOCOL_H
@@ -0,0 +1,156 @@
+#ifndef APP_SEQUENCER_H
+#define APP_SEQUENCER_H
+
+#include <cstdint>
+
+// On device valve program.
+// Each step turns a valve on for a duration, offset_sec after the program
+// starts or, if it has one, after the step it follows has finished. An
+// exclusive run holds a step back while any other valve is on, the program's
+// or not, so no more than one is on at a time. Steps are run from periodic()
+// at deadline(), valves are driven through a pulse(valve, duration_sec)
+// callable and an any_on() one says whether any valve is staying on.
+class Sequencer {
+ public:
+  static constexpr uint8_t MAX_STEPS = 16;
+  static constexpr uint8_t NONE = 0xff;
+  // How often a step held back by a valve the program didn't open retries.
+  static constexpr uint64_t RETRY_US = 1000 * 1000;
+
+  struct Step {
+    uint8_t valve;
+    uint8_t after;  // Step this one follows, or NONE.
+    uint16_t offset_sec;
+    uint16_t duration_sec;
+  };
+
+  Sequencer() : exclusive_{false}, running_{false} { clear(); }
+
+  // Steps can't be changed while running.
+  auto set(uint8_t index, const Step &step) -> bool {
+    if (running_ || index >= MAX_STEPS || step.after == index) return false;
+    if (step.after != NONE && step.after >= MAX_STEPS) return false;
+    steps_[index] = step;
+    state_[index] = State::IDLE;
+    return true;
+  }
+
+  auto clear() -> void {
+    if (running_) return;
+    for (auto &state : state_) state = State::EMPTY;
+  }
+
+  // False if there are no steps, or one follows a missing step or a cycle.
+  auto start(uint64_t now, bool exclusive) -> bool {
+    if (running_) return false;
+    bool any = false;
+    for (uint8_t i = 0; i < MAX_STEPS; ++i) {
+      if (state_[i] == State::EMPTY) continue;
+      any = true;
+      auto step = i;
+      for (uint8_t depth = 0; steps_[step].after != NONE; ++depth) {
+        step = steps_[step].after;
+        if (depth == MAX_STEPS || state_[step] == State::EMPTY) return false;
+      }
+    }
+    if (!any) return false;
+    for (uint8_t i = 0; i < MAX_STEPS; ++i) {
+      if (state_[i] == State::EMPTY) continue;
+      state_[i] = State::WAITING;
+      due_[i] = (steps_[i].after == NONE) ? now + seconds(steps_[i].offset_sec)
+                                          : 0;
+    }
+    exclusive_ = exclusive;
+    running_ = true;
+    return true;
+  }
+
+  // Turns off any valves the program has on.
+  template <typename Pulse>
+  auto stop(Pulse pulse) -> void {
+    for (uint8_t i = 0; i < MAX_STEPS; ++i) {
+      if (state_[i] == State::RUNNING) pulse(steps_[i].valve, 0U);
+      if (state_[i] != State::EMPTY) state_[i] = State::IDLE;
+    }
+    running_ = false;
+  }
+
+  auto running() const -> bool { return running_; }
+
+  template <typename Pulse, typename AnyOn>
+  auto periodic(uint64_t now, Pulse pulse, AnyOn any_on) -> void {
+    if (!running_) return;
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      uint64_t busy_until = 0;
+      for (uint8_t i = 0; i < MAX_STEPS; ++i) {
+        if (state_[i] != State::RUNNING) continue;
+        if (due_[i] > now) {
+          if (busy_until == 0 || due_[i] < busy_until) busy_until = due_[i];
+          continue;
+        }
+        state_[i] = State::DONE;
+        changed = true;
+        // Followers are timed from when this one finished.
+        for (uint8_t j = 0; j < MAX_STEPS; ++j) {
+          if (state_[j] == State::WAITING && steps_[j].after == i)
+            due_[j] = due_[i] + seconds(steps_[j].offset_sec);
+        }
+      }
+      for (uint8_t i = 0; i < MAX_STEPS; ++i) {
+        if (state_[i] != State::WAITING || due_[i] == 0 || due_[i] > now)
+          continue;
+        if (exclusive_ && busy_until != 0) {
+          // Try again when the running step finishes.
+          due_[i] = busy_until;
+          continue;
+        }
+        if (exclusive_ && any_on()) {
+          due_[i] = now + RETRY_US;
+          continue;
+        }
+        pulse(steps_[i].valve, steps_[i].duration_sec);
+        state_[i] = State::RUNNING;
+        due_[i] = now + seconds(steps_[i].duration_sec);
+        if (busy_until == 0 || due_[i] < busy_until) busy_until = due_[i];
+        changed = true;
+      }
+    }
+    running_ = false;
+    for (auto state : state_) {
+      if (state == State::WAITING || state == State::RUNNING) running_ = true;
+    }
+    if (!running_) {
+      for (auto &state : state_)
+        if (state == State::DONE) state = State::IDLE;
+    }
+  }
+
+  // Next step start or finish, zero when not running.
+  auto deadline() const -> uint64_t {
+    uint64_t deadline = 0;
+    if (!running_) return deadline;
+    for (uint8_t i = 0; i < MAX_STEPS; ++i) {
+      if (state_[i] != State::WAITING && state_[i] != State::RUNNING) continue;
+      if (due_[i] != 0 && (deadline == 0 || due_[i] < deadline))
+        deadline = due_[i];
+    }
+    return deadline;
+  }
+
+ private:
+  enum class State : uint8_t { EMPTY, IDLE, WAITING, RUNNING, DONE };
+
+  static constexpr auto seconds(uint16_t sec) -> uint64_t {
+    return sec * 1000ULL * 1000ULL;
+  }
+
+  Step steps_[MAX_STEPS];
+  State state_[MAX_STEPS];
+  uint64_t due_[MAX_STEPS];
+  bool exclusive_;
+  bool running_;
+};
+
+#endif  // APP_SEQUENCER_H
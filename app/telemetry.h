@@ -0,0 +1,90 @@
+#ifndef APP_TELEMETRY_H
+#define APP_TELEMETRY_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/protocol.h"
+#include "io/scheduler.h"
+
+// Push stream of sensor readings.
+// Each subscribed sensor is read every interval, but only readings from a new
+// measurement window are queued. Queued readings go out together once there
+// are batch of them, or MAX_LATENCY_US after the first so a slow sensor isn't
+// held back forever.
+class Telemetry {
+ public:
+  static constexpr uint8_t MAX_BATCH = 8;
+  static constexpr uint64_t MAX_LATENCY_US = 1000 * 1000;
+
+  Telemetry() : batch_{1}, count_{0}, flush_{0} {
+    for (auto &subscription : subscriptions_) subscription = Subscription{};
+  }
+
+  auto subscribe(uint8_t sensor, uint32_t interval_ms, uint8_t batch,
+                 uint64_t now) -> bool {
+    if (sensor >= protocol::NUM_SENSORS) return false;
+    if (batch > MAX_BATCH) return false;
+    auto &subscription = subscriptions_[sensor];
+    subscription.interval = interval_ms * 1000ULL;
+    subscription.next = (interval_ms == 0) ? 0 : now;
+    if (batch != 0) batch_ = batch;
+    return true;
+  }
+
+  // Due to be read at now. Moves the sensor on to its next interval.
+  auto due(uint8_t sensor, uint64_t now) -> bool {
+    auto &subscription = subscriptions_[sensor];
+    if (subscription.next == 0 || subscription.next > now) return false;
+    subscription.next += subscription.interval;
+    if (subscription.next <= now)
+      subscription.next = now + subscription.interval;
+    return true;
+  }
+
+  // Queue a reading unless it has been sent already. When output has backed
+  // up and the queue is full new readings are dropped.
+  auto add(const protocol::Reading &reading, uint32_t sequence,
+           uint64_t now) -> void {
+    auto &subscription = subscriptions_[reading.sensor];
+    if (subscription.sent && subscription.sequence == sequence) return;
+    if (count_ == MAX_BATCH) return;
+    subscription.sequence = sequence;
+    subscription.sent = true;
+    if (count_ == 0) flush_ = now + MAX_LATENCY_US;
+    readings_[count_++] = reading;
+  }
+
+  auto ready(uint64_t now) const -> bool {
+    return count_ != 0 && (count_ >= batch_ || flush_ <= now);
+  }
+  auto readings() const -> const protocol::Reading * { return readings_; }
+  auto count() const -> size_t { return count_; }
+  auto clear() -> void { count_ = 0; }
+
+  // Earliest time anything needs doing, zero if nothing is subscribed.
+  auto deadline() const -> uint64_t {
+    uint64_t deadline = (count_ != 0) ? flush_ : Scheduler::NEVER;
+    for (auto &subscription : subscriptions_) {
+      if (subscription.next != 0 && subscription.next < deadline)
+        deadline = subscription.next;
+    }
+    return (deadline == Scheduler::NEVER) ? 0 : deadline;
+  }
+
+ private:
+  struct Subscription {
+    uint64_t interval = 0;
+    uint64_t next = 0;  // Zero when not subscribed.
+    uint32_t sequence = 0;
+    bool sent = false;
+  };
+
+  Subscription subscriptions_[protocol::NUM_SENSORS];
+  protocol::Reading readings_[MAX_BATCH];
+  uint8_t batch_;
+  uint8_t count_;
+  uint64_t flush_;
+};
+
+#endif  // APP_TELEMETRY_H
@@ -1,47 +1,51 @@
 #ifndef APP_VALVE_H
 #define APP_VALVE_H
 
-#include "io/gpio.h"
 #include "pico/time.h"
 
-template <uint pin, bool active_high>
+// Valve state and shutoff timing. The pin is written by App along with the
+// rest of the valves in its GpioGroup, so valves changed together switch
+// together.
+template <uint pin>
 class Valve {
  public:
-  Valve() : next_{0} {}
+  Valve() : on_{false}, next_{0} {}
 
-  auto set(bool level) { pin_.set((level) ? active_high : !active_high); }
-  auto get() {
-    auto value = pin_.get();
-    return (active_high) ? value : !value;
-  }
-  constexpr auto get_pin() { return pin_.get_pin(); }
+  auto set(bool level) { on_ = level; }
+  auto get() { return on_; }
+  constexpr auto get_pin() { return pin; }
 
-  auto init() {
-    pin_.init();
-    set(false);
-  }
+  auto init() { set(false); }
 
-  auto periodic() {
-    if (next_ != 0 && next_ < time_us_64()) {
+  auto periodic(uint64_t now) {
+    if (next_ != 0 && next_ <= now) {
       set(false);
       next_ = 0;
     }
   }
 
-  auto pulse(unsigned on_duration_sec) {
+  // Zero when no shutoff is pending.
+  auto deadline() { return next_; }
+
+  auto close() {
+    set(false);
+    next_ = 0;
+  }
+
+  // On for a duration from now, which callers timing other things from the
+  // same pass give so they agree with the shutoff, off for 0.
+  auto pulse(unsigned on_duration_sec, uint64_t now) {
     if (on_duration_sec == 0) {
-      set(false);
-      next_ = 0;
+      close();
     } else {
       set(true);
-      next_ = (static_cast<uint64_t>(on_duration_sec) * 1000UL * 1000UL) +
-              time_us_64();
+      next_ = (static_cast<uint64_t>(on_duration_sec) * 1000UL * 1000UL) + now;
     }
   }
 
  private:
+  bool on_;
   uint64_t next_;
-  Gpio<pin, true> pin_;
 };
 
 #endif  // APP_VALVE_H
@@ -1,6 +1,9 @@
 #ifndef APP_CONFIG_H
 #define APP_CONFIG_H
 
+#include <cstddef>
+#include <cstdint>
+
 #include "pico/types.h"
 
 // LED defines.
@@ -20,11 +23,85 @@ constexpr bool VALVE1_ON = true;
 // UART Expansion Defines
 constexpr uint UART_TX_PIN = 4;
 constexpr uint UART_RX_PIN = 5;
+constexpr uint UART_INDEX = 1;
+constexpr uint UART_BAUD = 460800;
 
 // SENSOR defines
 constexpr uint MOISTURE0_PIN = 27;
 constexpr uint MOISTURE1_PIN = 29;
 constexpr uint FLOW0_PIN = 1;
 constexpr uint FLOW1_PIN = 7;
+// Default sample windows, as they have always been as the s status reply
+// counts edges over them. Each can be changed at run time with its setting.
+constexpr uint32_t MOISTURE_WINDOW_MS = 10 * 1000;
+constexpr uint32_t FLOW_WINDOW_MS = 2 * 1000;
+// Typical of hall effect flow sensors, around 7.5 Hz per litre a minute.
+constexpr uint32_t FLOW_PULSES_PER_LITRE = 450;
+
+// Channel tables, App has one Valve or Freq per entry in this order which is
+// also the index used by the api. Up to 16 valves and 16 sensors.
+constexpr uint8_t NO_SENSOR = 0xff;
+
+struct ValveConfig {
+  uint pin;
+  bool active_high;
+  const char *name;
+  uint8_t flow;  // Sensor metering this valve, or NO_SENSOR.
+  // Zero to take volumes as a count of pulses.
+  uint32_t pulses_per_litre;
+};
+
+struct SensorConfig {
+  uint pin;
+  uint32_t window_ms;
+  const char *name;
+  const char *key;  // In the status reply.
+};
+
+constexpr ValveConfig VALVES[] = {
+    {VALVE0_PIN, VALVE0_ON, "VALVE0", 2, FLOW_PULSES_PER_LITRE},
+    {VALVE1_PIN, VALVE1_ON, "VALVE1", 3, FLOW_PULSES_PER_LITRE},
+};
+
+constexpr SensorConfig SENSORS[] = {
+    {MOISTURE0_PIN, MOISTURE_WINDOW_MS, "MOISTURE0", "m0"},
+    {MOISTURE1_PIN, MOISTURE_WINDOW_MS, "MOISTURE1", "m1"},
+    {FLOW0_PIN, FLOW_WINDOW_MS, "FLOW0", "f0"},
+    {FLOW1_PIN, FLOW_WINDOW_MS, "FLOW1", "f1"},
+};
+
+constexpr size_t NUM_VALVES = sizeof(VALVES) / sizeof(VALVES[0]);
+constexpr size_t NUM_SENSORS = sizeof(SENSORS) / sizeof(SENSORS[0]);
+static_assert(NUM_VALVES <= 16 && NUM_SENSORS <= 16);
+
+constexpr auto valid_flows() -> bool {
+  for (const auto &valve : VALVES) {
+    if (valve.flow != NO_SENSOR && valve.flow >= NUM_SENSORS) return false;
+  }
+  return true;
+}
+static_assert(valid_flows(), "Valve flow sensor out of range");
+
+// Records kept in RAM for the history query, a power of 2. Sensors are only
+// recorded when their value changes but even with every window of every
+// sensor recorded at its default window the history must go back
+// HISTORY_SPAN_MS, for a host that missed polls to catch up from.
+constexpr uint32_t HISTORY_CAPACITY = 4096;
+constexpr uint32_t HISTORY_SPAN_MS = 30 * 60 * 1000;
+
+constexpr auto history_span_ms() -> uint64_t {
+  constexpr uint64_t HOUR_MS = 60 * 60 * 1000;
+  uint64_t per_hour = 0;
+  for (const auto &sensor : SENSORS) per_hour += HOUR_MS / sensor.window_ms;
+  return HISTORY_CAPACITY * HOUR_MS / per_hour;
+}
+static_assert(history_span_ms() >= HISTORY_SPAN_MS,
+              "History too small for its span at the default windows");
+
+// Api output held for usb. History replies fill what room there is so a
+// smaller ring only means more pages.
+#ifndef API_OUTPUT_BUFFER_SIZE
+#define API_OUTPUT_BUFFER_SIZE 2048
+#endif
 
 #endif  // APP_CONFIG_H
@@ -0,0 +1,98 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "harness.h"
+#include "io/conversion.h"
+
+// Throughput of the hot text paths, to compare builds before and after a
+// change. Times are host times so only the ratios mean anything.
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps results alive so the work isn't optimised away.
+static volatile size_t sink = 0;
+
+auto keep(size_t value) -> void { sink = sink + value; }
+
+template <typename Work>
+auto measure(const char *name, size_t operations, size_t bytes, Work work)
+    -> void {
+  work();  // Warm up.
+  auto start = Clock::now();
+  work();
+  auto elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+  printf("%-24s %10.1f ns/op", name, elapsed * 1e9 / operations);
+  if (bytes != 0) printf(" %8.1f MB/s", bytes / elapsed / 1e6);
+  printf("\n");
+}
+
+auto bench_conversion() -> void {
+  constexpr size_t COUNT = 1000000;
+  std::vector<unsigned long long> values(COUNT);
+  unsigned long long value = 1;
+  for (auto &v : values) {
+    value = value * 6364136223846793005ULL + 1442695040888963407ULL;
+    // Spread over every length of number.
+    v = value >> (value % 64);
+  }
+  Conversion conversion;
+  auto use = [&conversion](const char *format) { conversion.parse(format); };
+  use("u");
+  measure("from_unsigned_int", COUNT, 0, [&] {
+    for (auto v : values) keep(strlen(conversion.from_unsigned_int(v)));
+  });
+  use("d");
+  measure("from_signed_int", COUNT, 0, [&] {
+    for (auto v : values)
+      keep(strlen(conversion.from_signed_int(static_cast<long long>(v))));
+  });
+  use("u");
+  measure("from_unsigned_int small", COUNT, 0, [&] {
+    for (auto v : values) keep(strlen(conversion.from_unsigned_int(v & 0xff)));
+  });
+  use("g");
+  measure("from_double", COUNT / 10, 0, [&] {
+    for (size_t i = 0; i < COUNT / 10; ++i)
+      keep(strlen(conversion.from_double(static_cast<double>(values[i]) /
+                                            (1ULL << (i % 32)))));
+  });
+}
+
+// Console::read_done(), so the line editor, tokenise() and command lookup.
+auto bench_console() -> void {
+  std::string input;
+  constexpr size_t LINES = 100000;
+  for (size_t i = 0; i < LINES; ++i)
+    input += "echo 12 0x34 five six seven eight nine ten\r";
+  auto &console = harness::console();
+  measure("console line", LINES, input.size(), [&] {
+    harness::feed(console, reinterpret_cast<const uint8_t *>(input.data()),
+                  input.size());
+  });
+}
+
+// App::read_done() through the api Parser and the replies.
+auto bench_api() -> void {
+  std::string input;
+  constexpr size_t COMMANDS = 100000;
+  const char *commands[] = {"s\r", "v0:0\r", "t0:0\r", "c0\r", "h4294967295\r"};
+  for (size_t i = 0; i < COMMANDS; ++i) input += commands[i % 5];
+  auto &app = harness::app();
+  measure("api command", COMMANDS, input.size(), [&] {
+    harness::feed(app, reinterpret_cast<const uint8_t *>(input.data()),
+                  input.size());
+  });
+}
+
+}  // namespace
+
+int main() {
+  bench_conversion();
+  bench_console();
+  bench_api();
+  return 0;
+}
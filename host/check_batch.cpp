@@ -0,0 +1,125 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "app/protocol.h"
+#include "app_config.h"
+#include "hal.h"
+#include "harness.h"
+#include "io/frame.h"
+
+// Batches against a backed up api output: with no room for every reply
+// nothing is run, text or binary, and once the host has read what was
+// waiting the same batch runs.
+namespace {
+
+int failures = 0;
+
+auto expect(bool ok, const char *what) -> void {
+  if (ok) return;
+  fprintf(stderr, "FAIL %s\n", what);
+  ++failures;
+}
+
+// As the usb side, without reading anything back.
+auto send(const void *data, size_t length) -> void {
+  auto &app = harness::app();
+  auto bytes = static_cast<const uint8_t *>(data);
+  while (length != 0) {
+    auto [buffer, room] = app.read_buffer();
+    if (room == 0) return;
+    auto chunk = (length < room) ? length : room;
+    memcpy(buffer, bytes, chunk);
+    app.read_done(chunk);
+    bytes += chunk;
+    length -= chunk;
+  }
+}
+
+auto send(const char *text) -> void { send(text, strlen(text)); }
+
+auto send_frame(protocol::Type type, const void *payload, size_t length)
+    -> void {
+  uint8_t frame[Frame::MAX_PAYLOAD + Frame::OVERHEAD];
+  send(frame, Frame::encode(static_cast<uint8_t>(type), payload, length,
+                            frame));
+}
+
+auto received() -> std::string {
+  auto &app = harness::app();
+  std::string bytes;
+  for (;;) {
+    auto [data, length] = app.write_buffer();
+    if (length == 0) return bytes;
+    bytes.append(data, length);
+    app.write_done(length);
+  }
+}
+
+auto valve_on(uint8_t valve) -> bool {
+  harness::app().periodic();
+  return hal::level(VALVES[valve].pin) == VALVES[valve].active_high;
+}
+
+// Status polls nobody reads until the output is full.
+auto back_up() -> void {
+  for (size_t i = 0; i < 2 * API_OUTPUT_BUFFER_SIZE / 40; ++i) send("s\r");
+}
+
+auto check_text() -> void {
+  received();
+  back_up();
+  send("[v0:5 s]\r");
+  expect(!valve_on(0), "text batch run without room for its replies");
+  auto bytes = received();
+  expect(bytes.find("B2") == std::string::npos, "text batch replied");
+
+  send("[v0:5 s]\r");
+  expect(valve_on(0), "text batch not run with room");
+  bytes = received();
+  expect(bytes.compare(0, 4, "B2\r\n") == 0 &&
+             bytes.find("AV0\r\n") != std::string::npos &&
+             bytes.find("}\r\n") != std::string::npos,
+         "text batch replies");
+  send("v0:0\r");
+  expect(!valve_on(0), "valve closed");
+}
+
+auto check_binary() -> void {
+  send("m1\r");
+  received();
+  // Status replies, then NAKs of an unknown type for the last few bytes.
+  for (size_t i = 0; i < 2 * API_OUTPUT_BUFFER_SIZE / 40; ++i)
+    send_frame(protocol::Type::STATUS, nullptr, 0);
+  for (size_t i = 0; i < 8; ++i)
+    send_frame(static_cast<protocol::Type>(0x7f), nullptr, 0);
+  struct __attribute__((packed)) {
+    protocol::Entry entry;
+    protocol::ValveRequest valve;
+  } batch = {{protocol::Type::VALVE, sizeof(protocol::ValveRequest)}, {0, 5}};
+  send_frame(protocol::Type::BATCH, &batch, sizeof(batch));
+  expect(!valve_on(0), "binary batch run without room for its reply");
+  received();
+
+  send_frame(protocol::Type::BATCH, &batch, sizeof(batch));
+  expect(valve_on(0), "binary batch not run with room");
+  auto bytes = received();
+  expect(bytes.size() > 2 &&
+             bytes[2] == static_cast<char>(protocol::Type::BATCH_REPLY),
+         "binary batch reply");
+}
+
+}  // namespace
+
+int main() {
+  hal::set_time(1000);
+  harness::app();
+  check_text();
+  check_binary();
+  if (failures != 0) {
+    fprintf(stderr, "%d failed\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
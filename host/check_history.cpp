@@ -0,0 +1,154 @@
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "app/history.h"
+
+// History against a plain list of every record appended: sequence numbers,
+// times through deltas and GAP slots, the oldest being overwritten when it
+// wraps, and reads resumed from a cursor giving the same as one read.
+namespace {
+
+constexpr size_t CAPACITY = 16;
+using Log = History<CAPACITY>;
+
+int failures = 0;
+
+auto expect(bool ok, const char *what, int trial) -> void {
+  if (ok) return;
+  fprintf(stderr, "FAIL trial %d: %s\n", trial, what);
+  ++failures;
+}
+
+// Deterministic so a failure can be run again.
+struct Random {
+  uint64_t state;
+  auto next(uint32_t below) -> uint32_t {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return static_cast<uint32_t>((state >> 33) % below);
+  }
+};
+
+auto same(const Log::Record &a, const Log::Record &b) -> bool {
+  return a.sequence == b.sequence && a.time_ms == b.time_ms &&
+         a.value == b.value && a.source == b.source;
+}
+
+auto read_all(const Log &log, uint32_t from) -> std::vector<Log::Record> {
+  std::vector<Log::Record> records;
+  log.read(from, [&](const auto &record) {
+    records.push_back(record);
+    return true;
+  });
+  return records;
+}
+
+// A few at a time, each read carrying on from the cursor.
+auto read_chunked(const Log &log, uint32_t from, size_t per)
+    -> std::vector<Log::Record> {
+  std::vector<Log::Record> records;
+  auto cursor = log.begin();
+  for (;;) {
+    size_t count = 0;
+    log.read(from, cursor, [&](const auto &record) {
+      if (count == per) return false;
+      records.push_back(record);
+      ++count;
+      return true;
+    });
+    if (count < per) return records;
+  }
+}
+
+auto check_against_list(int trial, Random &random) -> void {
+  static Log log;
+  log = Log{};
+  std::vector<Log::Record> appended;
+  uint32_t time_ms = random.next(1u << 31);
+  uint32_t last_ms = 0;
+  auto appends = random.next(4 * CAPACITY);
+  for (uint32_t i = 0; i < appends; ++i) {
+    auto kind = random.next(10);
+    if (kind == 0) {
+      time_ms += 0x10000 + random.next(1000000);  // Needs a GAP slot.
+    } else if (kind == 1 && time_ms > 100) {
+      time_ms -= random.next(100);  // Clamped to the last time.
+    } else {
+      time_ms += random.next(2000);
+    }
+    auto source = static_cast<uint8_t>(random.next(4));
+    auto value = random.next(1000000);
+    log.append(source, value, time_ms);
+    // The first record's time is taken as it is.
+    if (i == 0 || static_cast<int32_t>(time_ms - last_ms) > 0)
+      last_ms = time_ms;
+    appended.push_back(Log::Record{i, last_ms, value, source});
+  }
+  expect(log.next_sequence() == appends, "next sequence", trial);
+
+  auto all = read_all(log, 0);
+  // GAP slots take room too, so anything from the newest CAPACITY / 2 on is
+  // certainly still there.
+  expect(all.size() <= CAPACITY, "no more than capacity", trial);
+  expect(all.size() >= appends || all.size() >= CAPACITY / 2,
+         "only the oldest overwritten", trial);
+  auto first = appends - static_cast<uint32_t>(all.size());
+  for (size_t i = 0; i < all.size(); ++i) {
+    if (!same(all[i], appended[first + i])) {
+      expect(false, "record as appended", trial);
+      break;
+    }
+  }
+
+  auto from = appends - random.next(CAPACITY + 4);
+  auto expected = read_all(log, from);
+  for (const auto &record : expected) {
+    if (static_cast<int32_t>(record.sequence - from) < 0) {
+      expect(false, "nothing before from", trial);
+      break;
+    }
+  }
+  for (size_t per = 1; per <= CAPACITY; ++per) {
+    auto chunked = read_chunked(log, from, per);
+    bool equal = chunked.size() == expected.size();
+    for (size_t i = 0; equal && i < chunked.size(); ++i)
+      equal = same(chunked[i], expected[i]);
+    if (!equal) {
+      expect(false, "cursor reads as one read", trial);
+      break;
+    }
+  }
+}
+
+// A refused record is where the next read starts.
+auto check_refused(int trial) -> void {
+  static Log log;
+  log = Log{};
+  for (uint32_t i = 0; i < 3 * CAPACITY; ++i) log.append(0, i, 1000 + i);
+  auto cursor = log.begin();
+  uint32_t seen = 0;
+  log.read(0, cursor, [&](const auto &record) {
+    seen = record.sequence;
+    return false;
+  });
+  uint32_t next = 0;
+  log.read(0, cursor, [&](const auto &record) {
+    next = record.sequence;
+    return false;
+  });
+  expect(seen == 2 * CAPACITY && next == seen, "refused record kept", trial);
+}
+
+}  // namespace
+
+int main() {
+  Random random{1};
+  for (int trial = 0; trial < 2000; ++trial) check_against_list(trial, random);
+  check_refused(-1);
+  if (failures != 0) {
+    fprintf(stderr, "%d failed\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "app_config.h"
+#include "hal.h"
+#include "harness.h"
+
+// The s status reply against what the baseline firmware gave: edges counted
+// over a 10 s moisture and 2 s flow window, marked '-' once they have been
+// shown, and an "m2" with no sensor.
+namespace {
+
+constexpr uint64_t STEP_US = 100 * 1000;
+
+int failures = 0;
+
+auto expect(bool ok, const char *what, const std::string &reply) -> void {
+  if (ok) return;
+  fprintf(stderr, "FAIL %s: %s", what, reply.c_str());
+  ++failures;
+}
+
+// A command fitting one read, with what the api channel replied.
+auto command(const char *text) -> std::string {
+  auto &app = harness::app();
+  harness::drain(app);
+  auto [buffer, room] = app.read_buffer();
+  auto length = strlen(text);
+  if (length > room) return {};
+  memcpy(buffer, text, length);
+  app.read_done(length);
+  std::string reply;
+  for (;;) {
+    auto [data, count] = app.write_buffer();
+    if (count == 0) return reply;
+    reply.append(data, count);
+    app.write_done(count);
+  }
+}
+
+// The mark and number after "<key>": in a status reply.
+auto field(const std::string &reply, const char *key, char &mark) -> long {
+  auto name = std::string("\"") + key + "\":";
+  auto at = reply.find(name);
+  if (at == std::string::npos) {
+    mark = '?';
+    return -1;
+  }
+  mark = reply[at + name.size()];
+  return strtol(reply.c_str() + at + name.size() + 1, nullptr, 10);
+}
+
+// Edges per step on each sensor, half way through the step so none fall on
+// a window boundary.
+auto run(uint64_t us, const uint32_t (&edges)[NUM_SENSORS]) -> void {
+  for (uint64_t elapsed = 0; elapsed < us; elapsed += STEP_US) {
+    hal::advance(STEP_US / 2);
+    for (size_t sensor = 0; sensor < NUM_SENSORS; ++sensor)
+      hal::edges(SENSORS[sensor].pin, edges[sensor]);
+    hal::advance(STEP_US / 2);
+    harness::app().periodic();
+  }
+}
+
+auto check(const char *key, long edges, char mark, const std::string &reply)
+    -> void {
+  char seen = 0;
+  auto value = field(reply, key, seen);
+  std::string what = std::string(key) + " is " + mark + std::to_string(edges);
+  expect(value == edges && seen == mark, what.c_str(), reply);
+}
+
+}  // namespace
+
+int main() {
+  hal::set_time(1000);
+  harness::app();
+
+  auto reply = command("s\r");
+  expect(reply.compare(0, 2, "R{") == 0, "status reply", reply);
+  for (auto key : {"m0", "m1", "m2", "f0", "f1"}) check(key, 0, '-', reply);
+
+  // 30, 0, 5 and 2 edges a 100 ms step, then a whole moisture window.
+  run(20 * 1000 * 1000, {30, 0, 5, 2});
+  reply = command("s\r");
+  check("m0", 3000, ' ', reply);
+  check("m1", 0, ' ', reply);
+  check("m2", 0, '-', reply);
+  check("f0", 100, ' ', reply);
+  check("f1", 40, ' ', reply);
+  reply = command("s\r");
+  check("m0", 3000, '-', reply);
+  check("f0", 100, '-', reply);
+
+  // A shorter flow window is still shown as edges a 2 s window, straight
+  // after the change and once windows of the new length have been counted.
+  command("c2:500\r");
+  reply = command("s\r");
+  check("f0", 100, '-', reply);
+  run(4 * 1000 * 1000, {30, 0, 5, 2});
+  reply = command("s\r");
+  check("f0", 100, ' ', reply);
+  command("c2:2000\r");
+
+  if (failures != 0) {
+    fprintf(stderr, "%d failed\n", failures);
+    return 1;
+  }
+  printf("ok\n");
+  return 0;
+}
@@ -0,0 +1,15 @@
+#include "hal.h"
+#include "harness.h"
+
+// App::read_done() with arbitrary bytes, text commands, batches and binary
+// frames once an input has switched modes. Time moves on a little each input
+// so valves, sequencer and telemetry run too.
+extern "C" auto LLVMFuzzerTestOneInput(const uint8_t *data,
+                                       size_t size) -> int {
+  auto &app = harness::app();
+  harness::feed(app, data, size);
+  hal::advance(10 * 1000);
+  app.periodic();
+  harness::drain(app);
+  return 0;
+}
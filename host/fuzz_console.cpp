@@ -0,0 +1,8 @@
+#include "harness.h"
+
+// Console::read_done() with arbitrary bytes, edits, escapes and commands.
+extern "C" auto LLVMFuzzerTestOneInput(const uint8_t *data,
+                                       size_t size) -> int {
+  harness::feed(harness::console(), data, size);
+  return 0;
+}
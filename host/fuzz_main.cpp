@@ -0,0 +1,39 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+// Driver for compilers without libFuzzer: replays the files given, or runs
+// random inputs biased towards the command characters.
+extern "C" auto LLVMFuzzerTestOneInput(const uint8_t *data,
+                                       size_t size) -> int;
+
+int main(int argc, char **argv) {
+  if (argc > 1) {
+    for (int i = 1; i < argc; ++i) {
+      std::ifstream file(argv[i], std::ios::binary);
+      std::vector<uint8_t> input{std::istreambuf_iterator<char>(file), {}};
+      LLVMFuzzerTestOneInput(input.data(), input.size());
+    }
+    return 0;
+  }
+  static const char alphabet[] = "svmrthpgwcibqk0123456789:,[] \r\n\x1b\x7f\x08";
+  auto runs = getenv("FUZZ_RUNS") ? atol(getenv("FUZZ_RUNS")) : 100000L;
+  std::mt19937 random{1};
+  std::vector<uint8_t> input;
+  for (long run = 0; run < runs; ++run) {
+    input.resize(random() % 256);
+    for (auto &byte : input) {
+      byte = (random() % 4 == 0)
+                 ? static_cast<uint8_t>(random())
+                 : static_cast<uint8_t>(
+                       alphabet[random() % (sizeof(alphabet) - 1)]);
+    }
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+  printf("%ld inputs\n", runs);
+  return 0;
+}
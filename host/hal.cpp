@@ -0,0 +1,395 @@
+#include "hal.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/flash.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/pll.h"
+#include "hardware/pwm.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "hardware/uart.h"
+#include "hardware/watchdog.h"
+#include "pico/bootrom.h"
+#include "pico/flash.h"
+#include "pico/multicore.h"
+#include "pico/time.h"
+#include "tusb.h"
+
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+pll_hw_t host_pll_sys = {1};
+pll_hw_t host_pll_usb = {1};
+
+namespace {
+
+constexpr unsigned NUM_GPIOS = 30;
+
+static uint64_t now_us = 0;
+// Scheduler alarm target, and __wfe() calls.
+static uint64_t alarm_target = UINT64_MAX;
+static uint64_t wfe_count = 0;
+static bool gpio_levels[NUM_GPIOS] = {};
+static uint32_t slice_counts[NUM_PWM_SLICES] = {};
+static uint16_t slice_levels[NUM_PWM_SLICES][2] = {};
+static std::deque<uint8_t> usb_in[CFG_TUD_CDC];
+static std::string usb_out[CFG_TUD_CDC];
+// Written but not yet sent, and packets sent, by cdc channel.
+constexpr uint32_t USB_FIFO_SIZE = 256;
+constexpr uint32_t USB_PACKET_SIZE = 64;
+static std::string usb_fifo[CFG_TUD_CDC];
+static uint32_t usb_sent[CFG_TUD_CDC] = {};
+// As left by the runtime's clock setup.
+static uint32_t clock_hz[CLK_COUNT] = {
+    0, 0, 0, 0, 12000000, SYS_CLK_HZ, SYS_CLK_HZ, USB_CLK_HZ, USB_CLK_HZ,
+    46875};
+
+// Only uart link transfers are simulated, the receive channel writes into
+// its ring as bytes are sent and the transmit one completes at once.
+constexpr uint DREQ_UART_TX = 1;
+constexpr uint DREQ_UART_RX = 2;
+constexpr uint NUM_DMA_CHANNELS = 12;
+struct DmaChannel {
+  dma_channel_hw_t hw;
+  dma_channel_config config;
+  uint8_t *write;
+  uint32_t written;
+};
+static DmaChannel dma_channels[NUM_DMA_CHANNELS] = {};
+static uint dma_claimed = 0;
+static uart_inst_t uarts[2] = {{{0}, 0}, {{0}, 1}};
+static std::string link_out;
+static uint32_t watchdog_ms = 0;
+static uint64_t watchdog_fed = 0;
+static bool watchdog_rebooted = false;
+
+// Alarm pool alarms, run by advance() as their time comes round.
+struct Alarm {
+  alarm_id_t id;
+  uint64_t target;
+  alarm_callback_t callback;
+  void *data;
+};
+static std::vector<Alarm> alarms;
+static alarm_id_t next_alarm_id = 1;
+
+// True when the alarm repeats, with its target moved on.
+auto fire(Alarm &alarm) -> bool {
+  auto result = alarm.callback(alarm.id, alarm.data);
+  if (result == 0) return false;
+  alarm.target = (result < 0) ? alarm.target - result : now_us + result;
+  return true;
+}
+
+auto run_alarms(uint64_t until) -> void {
+  for (;;) {
+    auto next = std::min_element(
+        alarms.begin(), alarms.end(),
+        [](const Alarm &a, const Alarm &b) { return a.target < b.target; });
+    if (next == alarms.end() || next->target > until) break;
+    // Callbacks can add and cancel alarms, so this one is taken out first.
+    auto alarm = *next;
+    alarms.erase(next);
+    if (alarm.target > now_us) now_us = alarm.target;
+    if (fire(alarm)) alarms.push_back(alarm);
+  }
+  now_us = until;
+  if (alarm_target <= now_us) alarm_target = UINT64_MAX;
+}
+[[maybe_unused]] static bool flash_erased = [] {
+  memset(host_flash, 0xff, sizeof(host_flash));
+  return true;
+}();
+
+}  // namespace
+
+namespace hal {
+
+auto set_time(uint64_t us) -> void { now_us = us; }
+auto advance(uint64_t us) -> void { run_alarms(now_us + us); }
+
+auto edges(unsigned gpio, uint32_t count) -> void {
+  slice_counts[pwm_gpio_to_slice_num(gpio)] += count;
+}
+auto level(unsigned gpio) -> bool { return gpio_levels[gpio]; }
+auto pwm_level(unsigned gpio) -> uint16_t {
+  return slice_levels[pwm_gpio_to_slice_num(gpio)][pwm_gpio_to_channel(gpio)];
+}
+
+auto usb_send(uint8_t channel, const void *data, size_t length) -> void {
+  auto bytes = static_cast<const uint8_t *>(data);
+  usb_in[channel].insert(usb_in[channel].end(), bytes, bytes + length);
+}
+auto usb_received(uint8_t channel) -> std::string {
+  std::string result;
+  result.swap(usb_out[channel]);
+  return result;
+}
+
+auto link_send(const void *data, size_t length) -> void {
+  auto bytes = static_cast<const uint8_t *>(data);
+  for (auto &channel : dma_channels) {
+    if (channel.config.dreq != DREQ_UART_RX || channel.write == nullptr)
+      continue;
+    auto mask = (1u << channel.config.ring_bits) - 1;
+    for (size_t i = 0; i < length && channel.hw.transfer_count != 0; ++i) {
+      channel.write[channel.written++ & mask] = bytes[i];
+      channel.hw.transfer_count = channel.hw.transfer_count - 1;
+    }
+  }
+}
+auto link_received() -> std::string {
+  std::string result;
+  result.swap(link_out);
+  return result;
+}
+
+auto watchdog_starved() -> bool {
+  return watchdog_ms != 0 && now_us - watchdog_fed > watchdog_ms * 1000ULL;
+}
+auto watchdog_reset(bool rebooted) -> void { watchdog_rebooted = rebooted; }
+
+auto usb_packets(uint8_t channel) -> uint32_t { return usb_sent[channel]; }
+
+auto sleeps() -> uint64_t { return wfe_count; }
+auto next_wake() -> uint64_t {
+  auto wake = alarm_target;
+  for (const auto &alarm : alarms) wake = std::min(wake, alarm.target);
+  return wake;
+}
+
+auto sys_clock_hz() -> uint32_t { return clock_hz[clk_sys]; }
+
+auto erase_flash() -> void { memset(host_flash, 0xff, sizeof(host_flash)); }
+
+}  // namespace hal
+
+// Time.
+auto time_us_64() -> uint64_t { return now_us; }
+auto time_us_32() -> uint32_t { return static_cast<uint32_t>(now_us); }
+auto sleep_ms(uint32_t ms) -> void { run_alarms(now_us + (ms * 1000ULL)); }
+auto add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data,
+                     bool fire_if_past) -> alarm_id_t {
+  auto alarm = Alarm{next_alarm_id++, now_us + us, callback, user_data};
+  if (us == 0 && fire_if_past && !fire(alarm)) return 0;
+  alarms.push_back(alarm);
+  return alarm.id;
+}
+auto cancel_alarm(alarm_id_t alarm_id) -> bool {
+  auto found = std::find_if(
+      alarms.begin(), alarms.end(),
+      [alarm_id](const Alarm &alarm) { return alarm.id == alarm_id; });
+  if (found == alarms.end()) return false;
+  alarms.erase(found);
+  return true;
+}
+auto hardware_alarm_claim_unused(bool) -> int { return 0; }
+auto hardware_alarm_set_callback(uint, hardware_alarm_callback_t) -> void {}
+auto hardware_alarm_set_target(uint, absolute_time_t t) -> bool {
+  if (t <= now_us) return true;
+  alarm_target = t;
+  return false;
+}
+auto hardware_alarm_cancel(uint) -> void { alarm_target = UINT64_MAX; }
+auto __wfe() -> void { ++wfe_count; }
+
+// Interrupts, there are none so nothing to mask.
+auto save_and_disable_interrupts() -> uint32_t { return 0; }
+auto restore_interrupts(uint32_t) -> void {}
+auto irq_add_shared_handler(uint, irq_handler_t, uint8_t) -> void {}
+auto irq_set_enabled(uint, bool) -> void {}
+
+// Gpio.
+auto gpio_init(uint gpio) -> void { gpio_levels[gpio] = false; }
+auto gpio_set_dir(uint, bool) -> void {}
+auto gpio_put(uint gpio, bool value) -> void { gpio_levels[gpio] = value; }
+auto gpio_get(uint gpio) -> bool { return gpio_levels[gpio]; }
+auto gpio_init_mask(uint gpio_mask) -> void {
+  for (uint gpio = 0; gpio < NUM_GPIOS; ++gpio)
+    if (gpio_mask & (1u << gpio)) gpio_init(gpio);
+}
+auto gpio_set_dir_out_masked(uint32_t) -> void {}
+auto gpio_put_masked(uint32_t mask, uint32_t value) -> void {
+  for (uint gpio = 0; gpio < NUM_GPIOS; ++gpio)
+    if (mask & (1u << gpio)) gpio_levels[gpio] = (value >> gpio) & 1u;
+}
+auto gpio_get_all() -> uint32_t {
+  uint32_t all = 0;
+  for (uint gpio = 0; gpio < NUM_GPIOS; ++gpio)
+    if (gpio_levels[gpio]) all |= 1u << gpio;
+  return all;
+}
+auto gpio_set_function(uint, gpio_function) -> void {}
+auto gpio_set_irq_enabled(uint, uint32_t, bool) -> void {}
+auto gpio_add_raw_irq_handler(uint, void (*)()) -> void {}
+auto gpio_acknowledge_irq(uint, uint32_t) -> void {}
+auto gpio_get_irq_event_mask(uint) -> uint32_t { return 0; }
+
+// Pwm, counters are the low 16 bits of the simulated edge counts and the
+// wraps are never pending.
+auto pwm_get_default_config() -> pwm_config { return pwm_config{}; }
+auto pwm_config_set_clkdiv_mode(pwm_config *, pwm_clkdiv_mode) -> void {}
+auto pwm_gpio_to_slice_num(uint gpio) -> uint { return (gpio >> 1) & 7u; }
+auto pwm_gpio_to_channel(uint gpio) -> uint { return gpio & 1u; }
+auto pwm_init(uint, pwm_config *, bool) -> void {}
+auto pwm_set_enabled(uint, bool) -> void {}
+auto pwm_set_wrap(uint, uint16_t) -> void {}
+auto pwm_set_gpio_level(uint gpio, uint16_t level) -> void {
+  slice_levels[pwm_gpio_to_slice_num(gpio)][pwm_gpio_to_channel(gpio)] = level;
+}
+auto pwm_set_chan_level(uint slice, uint chan, uint16_t level) -> void {
+  slice_levels[slice][chan] = level;
+}
+auto pwm_set_both_levels(uint slice, uint16_t level_a,
+                         uint16_t level_b) -> void {
+  slice_levels[slice][PWM_CHAN_A] = level_a;
+  slice_levels[slice][PWM_CHAN_B] = level_b;
+}
+auto pwm_get_counter(uint slice) -> uint16_t {
+  return static_cast<uint16_t>(slice_counts[slice]);
+}
+auto pwm_clear_irq(uint) -> void {}
+auto pwm_set_irq_enabled(uint, bool) -> void {}
+auto pwm_get_irq_status_mask() -> uint32_t { return 0; }
+
+// Uart and dma.
+auto uart_get_instance(uint num) -> uart_inst_t * { return &uarts[num]; }
+auto uart_get_hw(uart_inst_t *uart) -> uart_hw_t * { return &uart->hw; }
+auto uart_init(uart_inst_t *, uint baudrate) -> uint { return baudrate; }
+auto uart_get_dreq(uart_inst_t *, bool is_tx) -> uint {
+  return is_tx ? DREQ_UART_TX : DREQ_UART_RX;
+}
+auto dma_claim_unused_channel(bool) -> int {
+  return static_cast<int>(dma_claimed++);
+}
+auto dma_channel_get_default_config(uint) -> dma_channel_config {
+  return dma_channel_config{0, 0};
+}
+auto channel_config_set_transfer_data_size(dma_channel_config *,
+                                           dma_channel_transfer_size) -> void {}
+auto channel_config_set_read_increment(dma_channel_config *, bool) -> void {}
+auto channel_config_set_write_increment(dma_channel_config *, bool) -> void {}
+auto channel_config_set_ring(dma_channel_config *c, bool,
+                             uint size_bits) -> void {
+  c->ring_bits = size_bits;
+}
+auto channel_config_set_dreq(dma_channel_config *c, uint dreq) -> void {
+  c->dreq = dreq;
+}
+auto dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr, const volatile void *,
+                           uint transfer_count, bool trigger) -> void {
+  auto &dma = dma_channels[channel];
+  dma.config = *config;
+  dma.write = static_cast<uint8_t *>(const_cast<void *>(write_addr));
+  dma.hw.transfer_count = trigger ? transfer_count : 0;
+}
+auto dma_channel_is_busy(uint channel) -> bool {
+  return dma_channels[channel].hw.transfer_count != 0;
+}
+auto dma_channel_set_trans_count(uint channel, uint32_t trans_count,
+                                 bool trigger) -> void {
+  if (trigger) dma_channels[channel].hw.transfer_count = trans_count;
+}
+auto dma_channel_transfer_from_buffer_now(uint, const volatile void *read_addr,
+                                          uint32_t transfer_count) -> void {
+  auto bytes = static_cast<const char *>(const_cast<const void *>(read_addr));
+  link_out.append(bytes, transfer_count);
+}
+auto dma_channel_hw_addr(uint channel) -> dma_channel_hw_t * {
+  return &dma_channels[channel].hw;
+}
+
+// Clocks only keep their frequency, a clock left running from a stopped pll
+// is an error.
+auto clock_configure(clock_handle_t clock, uint32_t, uint32_t auxsrc,
+                     uint32_t, uint32_t freq) -> bool {
+  if (clock == clk_sys &&
+      auxsrc == CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS &&
+      host_pll_sys.cs == 0)
+    abort();
+  clock_hz[clock] = freq;
+  return true;
+}
+auto clock_stop(clock_handle_t clock) -> void { clock_hz[clock] = 0; }
+auto clock_get_hz(clock_handle_t clock) -> uint32_t { return clock_hz[clock]; }
+auto pll_init(PLL pll, uint, uint, uint, uint) -> void { pll->cs = 1; }
+auto pll_deinit(PLL pll) -> void {
+  if (pll == pll_sys && clock_hz[clk_sys] == SYS_CLK_HZ) abort();
+  pll->cs = 0;
+}
+
+// Flash, programming can only clear bits as on the real part.
+auto flash_range_erase(uint32_t offset, size_t count) -> void {
+  memset(&host_flash[offset], 0xff, count);
+}
+auto flash_range_program(uint32_t offset, const uint8_t *data,
+                         size_t count) -> void {
+  for (size_t i = 0; i < count; ++i) host_flash[offset + i] &= data[i];
+}
+auto flash_safe_execute(void (*func)(void *), void *param, uint32_t) -> int {
+  func(param);
+  return PICO_OK;
+}
+auto flash_safe_execute_core_init() -> bool { return true; }
+
+// Resets and the second core aren't simulated, the watchdog only keeps
+// time.
+auto watchdog_reboot(uint32_t, uint32_t, uint32_t) -> void {}
+auto watchdog_enable(uint32_t delay_ms, bool) -> void {
+  watchdog_ms = delay_ms;
+  watchdog_fed = now_us;
+}
+auto watchdog_update() -> void { watchdog_fed = now_us; }
+auto watchdog_caused_reboot() -> bool { return watchdog_rebooted; }
+auto watchdog_enable_caused_reboot() -> bool { return watchdog_rebooted; }
+auto reset_usb_boot(uint32_t, uint32_t) -> void {}
+auto multicore_launch_core1(void (*)()) -> void {}
+
+// Usb cdc, always connected and the host takes each packet as it is sent.
+auto tusb_init() -> bool { return true; }
+auto tud_task() -> void {}
+auto tud_task_event_ready() -> bool { return false; }
+auto tud_cdc_n_available(uint8_t itf) -> uint32_t {
+  return static_cast<uint32_t>(usb_in[itf].size());
+}
+auto tud_cdc_n_read(uint8_t itf, void *buffer, uint32_t bufsize) -> uint32_t {
+  auto bytes = static_cast<uint8_t *>(buffer);
+  uint32_t count = 0;
+  while (count < bufsize && !usb_in[itf].empty()) {
+    bytes[count++] = usb_in[itf].front();
+    usb_in[itf].pop_front();
+  }
+  return count;
+}
+auto tud_cdc_n_write_available(uint8_t itf) -> uint32_t {
+  return USB_FIFO_SIZE - static_cast<uint32_t>(usb_fifo[itf].size());
+}
+auto tud_cdc_n_write(uint8_t itf, const void *buffer,
+                     uint32_t bufsize) -> uint32_t {
+  auto count = std::min(bufsize, tud_cdc_n_write_available(itf));
+  auto &fifo = usb_fifo[itf];
+  fifo.append(static_cast<const char *>(buffer), count);
+  // Full packets go as soon as they're written.
+  while (fifo.size() >= USB_PACKET_SIZE) {
+    usb_out[itf].append(fifo, 0, USB_PACKET_SIZE);
+    fifo.erase(0, USB_PACKET_SIZE);
+    ++usb_sent[itf];
+  }
+  return count;
+}
+auto tud_cdc_n_write_flush(uint8_t itf) -> uint32_t {
+  auto &fifo = usb_fifo[itf];
+  auto count = static_cast<uint32_t>(fifo.size());
+  if (count == 0) return 0;
+  usb_out[itf] += fifo;
+  fifo.clear();
+  ++usb_sent[itf];
+  return count;
+}
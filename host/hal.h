@@ -0,0 +1,50 @@
+#ifndef HOST_HAL_H
+#define HOST_HAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Controls for the host shim's simulated hardware.
+namespace hal {
+
+// Time only moves when told to, alarms due on the way are run.
+auto set_time(uint64_t us) -> void;
+auto advance(uint64_t us) -> void;
+
+// Rising edges on a PWM B pin, counted by its slice.
+auto edges(unsigned gpio, uint32_t count) -> void;
+auto level(unsigned gpio) -> bool;
+// Compare level last set for a pwm pin.
+auto pwm_level(unsigned gpio) -> uint16_t;
+
+// Bytes for and from a usb cdc channel.
+auto usb_send(uint8_t channel, const void *data, size_t length) -> void;
+auto usb_received(uint8_t channel) -> std::string;
+// Packets sent on a channel, full ones as written and short ones by flushes.
+auto usb_packets(uint8_t channel) -> uint32_t;
+
+// Bytes for and from the uart link, sends are dropped while its receive DMA
+// isn't running.
+auto link_send(const void *data, size_t length) -> void;
+auto link_received() -> std::string;
+
+// Whether the watchdog has gone unfed past its timeout, and what
+// watchdog_enable_caused_reboot() says.
+auto watchdog_starved() -> bool;
+auto watchdog_reset(bool rebooted) -> void;
+
+// Times the core has gone to sleep in __wfe(), and the earliest alarm that
+// would wake it, UINT64_MAX for none.
+auto sleeps() -> uint64_t;
+auto next_wake() -> uint64_t;
+
+// Last frequency clk_sys was configured for.
+auto sys_clock_hz() -> uint32_t;
+
+// Erases the simulated flash.
+auto erase_flash() -> void;
+
+}  // namespace hal
+
+#endif  // HOST_HAL_H
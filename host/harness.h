@@ -0,0 +1,69 @@
+#ifndef HOST_HARNESS_H
+#define HOST_HARNESS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "app/app.h"
+#include "io/framework.h"
+
+// Shared set up for the benchmarks and fuzzers, one Framework and App for
+// the process as on the device.
+namespace harness {
+
+inline auto echo(Console &, Console::CommandLine &tokens) -> void {
+  for (size_t i = 0; i < tokens.number; ++i) {
+    uint32_t value = 0;
+    tokens.parameters[i].to_unsigned(value);
+  }
+}
+
+constexpr Console::Command command_list[] = {
+    {"help", echo}, {"echo", echo}, {"config", echo}};
+inline constexpr auto commands = Console::sorted(command_list);
+
+inline auto framework() -> Framework & {
+  static auto &framework = []() -> Framework & {
+    auto &framework = Framework::get("host\r\n", Console::table(commands));
+    static auto app = App{framework};
+    framework.app(&app);
+    framework.init();
+    return framework;
+  }();
+  return framework;
+}
+
+inline auto app() -> AppApi & { return *framework().app(); }
+inline auto console() -> Console & { return framework().console(); }
+
+// Everything written so far is thrown away.
+template <typename Endpoint>
+auto drain(Endpoint &endpoint) -> size_t {
+  size_t total = 0;
+  for (;;) {
+    auto [data, length] = endpoint.write_buffer();
+    if (length == 0) return total;
+    endpoint.write_done(length);
+    total += length;
+  }
+}
+
+// Feed bytes in read_buffer() sized pieces, draining the output as the usb
+// side would.
+template <typename Endpoint>
+auto feed(Endpoint &endpoint, const uint8_t *data, size_t length) -> void {
+  while (length != 0) {
+    auto [buffer, room] = endpoint.read_buffer();
+    auto chunk = (length < room) ? length : room;
+    memcpy(buffer, data, chunk);
+    endpoint.read_done(chunk);
+    drain(endpoint);
+    data += chunk;
+    length -= chunk;
+  }
+}
+
+}  // namespace harness
+
+#endif  // HOST_HARNESS_H
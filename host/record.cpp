@@ -0,0 +1,135 @@
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "app_config.h"
+#include "trace.h"
+
+// Records a trace, see trace.h, from a real device. Sits between the device
+// and whatever talks to it on a pseudo terminal, passing bytes both ways:
+//
+//   record /dev/ttyACM0 [channel] > session.trace
+//
+// then point the host program at the terminal named on stderr. What the
+// host sends is recorded as it arrives. The pulse streams can't be seen from
+// here, so the sensor rates in the device's q<generation> text status replies
+// are recorded as frequency events instead, the replay then pulses at the
+// rate the device was measuring. The s reply only has edge counts and binary
+// status replies aren't decoded.
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+auto raw(int fd) -> bool {
+  termios settings;
+  if (tcgetattr(fd, &settings) != 0) return false;
+  cfmakeraw(&settings);
+  return tcsetattr(fd, TCSANOW, &settings) == 0;
+}
+
+// Sensor rates last seen in a status reply, in mHz.
+struct Rates {
+  uint64_t mhz[NUM_SENSORS];
+  bool known[NUM_SENSORS];
+  std::string line;
+
+  // Each sensor's ,"<key>":<mark><integer>.<milli> in a status line.
+  auto scan(uint64_t us) -> void {
+    if (line.compare(0, 2, "R{") != 0) return;
+    for (uint8_t sensor = 0; sensor < NUM_SENSORS; ++sensor) {
+      auto key = std::string(",\"") + SENSORS[sensor].key + "\":";
+      auto at = line.find(key);
+      if (at == std::string::npos || at + key.size() + 1 >= line.size())
+        continue;
+      char *end = nullptr;
+      auto text = line.c_str() + at + key.size() + 1;
+      auto whole = strtoull(text, &end, 10);
+      if (end == text || *end != '.') continue;
+      auto milli = strtoull(end + 1, nullptr, 10);
+      auto value = whole * 1000 + milli;
+      if (known[sensor] && mhz[sensor] == value) continue;
+      known[sensor] = true;
+      mhz[sensor] = value;
+      trace::write(stdout, trace::Event{us, trace::Event::FREQUENCY, sensor,
+                                        value, {}});
+    }
+  }
+
+  auto add(const char *data, size_t length, uint64_t us) -> void {
+    for (size_t i = 0; i < length; ++i) {
+      if (data[i] == '\r' || data[i] == '\n') {
+        scan(us);
+        line.clear();
+      } else if (line.size() < 256) {
+        line += data[i];
+      }
+    }
+  }
+};
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <device> [channel]\n", argv[0]);
+    return 2;
+  }
+  auto channel = static_cast<uint8_t>((argc > 2) ? atoi(argv[2]) : 0);
+  auto device = open(argv[1], O_RDWR | O_NOCTTY);
+  if (device < 0 || !raw(device)) {
+    perror(argv[1]);
+    return 1;
+  }
+  auto terminal = posix_openpt(O_RDWR | O_NOCTTY);
+  if (terminal < 0 || grantpt(terminal) != 0 || unlockpt(terminal) != 0) {
+    perror("pseudo terminal");
+    return 1;
+  }
+  // Held open so the terminal doesn't hang up between host programs.
+  auto name = ptsname(terminal);
+  auto keep = open(name, O_RDWR | O_NOCTTY);
+  if (keep < 0 || !raw(keep)) {
+    perror(name);
+    return 1;
+  }
+  fprintf(stderr, "recording %s through %s\n", argv[1], name);
+  printf("# recorded from %s on channel %u\n", argv[1], channel);
+
+  Rates rates{};
+  auto start = Clock::now();
+  auto elapsed = [start] {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() -
+                                                              start)
+            .count());
+  };
+  char buffer[512];
+  for (;;) {
+    pollfd fds[] = {{terminal, POLLIN, 0}, {device, POLLIN, 0}};
+    if (poll(fds, 2, -1) < 0) break;
+    if (fds[0].revents & POLLIN) {
+      auto count = read(terminal, buffer, sizeof(buffer));
+      if (count <= 0) break;
+      auto us = elapsed();
+      trace::write(stdout, trace::Event{us, trace::Event::USB, channel, 0,
+                                        std::string(buffer, count)});
+      if (write(device, buffer, count) != count) break;
+    }
+    if (fds[1].revents & POLLIN) {
+      auto count = read(device, buffer, sizeof(buffer));
+      if (count <= 0) break;
+      rates.add(buffer, count, elapsed());
+      if (write(terminal, buffer, count) != count) break;
+    }
+    if ((fds[0].revents | fds[1].revents) & (POLLERR | POLLHUP)) break;
+    fflush(stdout);
+  }
+  return 0;
+}
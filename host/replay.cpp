@@ -0,0 +1,236 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "app_config.h"
+#include "hal.h"
+#include "hardware/flash.h"
+#include "harness.h"
+#include "trace.h"
+
+// Replays a trace, see trace.h, against the firmware on simulated time. The
+// main loop runs as on the device, periodic() then wait(), and time jumps
+// straight to whatever the core would wake for next: the next event, a
+// scheduler deadline or an alarm. The same trace and firmware always give
+// the same output so its checksum shows whether a change altered behaviour,
+// and the rest of the report whether it was faster or used more buffering:
+//
+//   replay <trace> [settle_ms]
+//
+// Latencies run from an input on a usb channel to the first output on it
+// after, three ways: in simulated time, which takes in scheduling and flush
+// coalescing but not the time the code takes to run, in main loop passes,
+// and in the host time those passes took. Host times are only meaningful as
+// ratios between builds.
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t NUM_CHANNELS = 2;
+// Passes without sleeping before time is moved on anyway.
+constexpr size_t MAX_SPINS = 1000;
+
+// A sensor's edges from its rate, counted from when the rate was set.
+struct Source {
+  uint64_t mhz = 0;
+  uint64_t since = 0;
+  uint64_t counted = 0;
+};
+
+// An input not yet answered, with the passes run since it came.
+struct Pending {
+  uint64_t us;
+  uint32_t passes;
+  uint64_t ns;
+};
+
+struct Replay {
+  Source sources[NUM_SENSORS];
+  std::vector<Pending> pending[NUM_CHANNELS];
+  std::vector<uint32_t> latency_us;
+  std::vector<uint32_t> latency_passes;
+  std::vector<uint32_t> latency_ns;
+  std::vector<uint32_t> pass_ns;
+  uint64_t start = 0;
+  uint64_t inputs = 0;
+  uint64_t output_bytes = 0;
+  uint64_t checksum = 0xcbf29ce484222325;  // FNV-1a.
+
+  auto hash(const void *data, size_t length) -> void {
+    auto bytes = static_cast<const uint8_t *>(data);
+    for (size_t i = 0; i < length; ++i)
+      checksum = (checksum ^ bytes[i]) * 0x100000001b3;
+  }
+
+  // Output is hashed with the time and where it went, so a change in when
+  // a reply goes shows as well as what's in it.
+  auto collect(uint64_t now) -> void {
+    auto take = [this, now](uint8_t where, const std::string &bytes) {
+      if (bytes.empty()) return;
+      auto at = now - start;
+      hash(&at, sizeof(at));
+      hash(&where, sizeof(where));
+      hash(bytes.data(), bytes.size());
+      output_bytes += bytes.size();
+    };
+    for (uint8_t channel = 0; channel < NUM_CHANNELS; ++channel) {
+      auto bytes = hal::usb_received(channel);
+      if (bytes.empty()) continue;
+      take(channel, bytes);
+      for (const auto &input : pending[channel]) {
+        latency_us.push_back(static_cast<uint32_t>(now - input.us));
+        latency_passes.push_back(input.passes);
+        latency_ns.push_back(static_cast<uint32_t>(input.ns));
+      }
+      pending[channel].clear();
+    }
+    take(NUM_CHANNELS, hal::link_received());
+  }
+
+  auto pulse(uint64_t now) -> void {
+    for (size_t sensor = 0; sensor < NUM_SENSORS; ++sensor) {
+      auto &source = sources[sensor];
+      auto total = static_cast<uint64_t>(
+          static_cast<unsigned __int128>(source.mhz) * (now - source.since) /
+          1000000000);
+      if (total == source.counted) continue;
+      hal::edges(SENSORS[sensor].pin,
+                 static_cast<uint32_t>(total - source.counted));
+      source.counted = total;
+    }
+  }
+
+  // Main loop passes up to the time given.
+  auto run(Framework &framework, uint64_t until) -> void {
+    size_t spins = 0;
+    for (;;) {
+      auto now = time_us_64();
+      pulse(now);
+      auto begin = Clock::now();
+      framework.periodic();
+      auto sleeps = hal::sleeps();
+      framework.wait();
+      auto ns = static_cast<uint32_t>(
+          std::chrono::nanoseconds(Clock::now() - begin).count());
+      pass_ns.push_back(ns);
+      for (auto &inputs : pending) {
+        for (auto &input : inputs) {
+          ++input.passes;
+          input.ns += ns;
+        }
+      }
+      collect(now);
+      if (now >= until) return;
+      if (hal::sleeps() == sleeps && ++spins < MAX_SPINS) continue;
+      spins = 0;
+      auto wake = std::min(std::max(hal::next_wake(), now + 1), until);
+      hal::advance(wake - now);
+    }
+  }
+
+  auto apply(const trace::Event &event, uint64_t now) -> void {
+    switch (event.type) {
+      case trace::Event::USB:
+        if (event.index >= NUM_CHANNELS) break;
+        hal::usb_send(event.index, event.bytes.data(), event.bytes.size());
+        pending[event.index].push_back(Pending{now, 0, 0});
+        ++inputs;
+        break;
+      case trace::Event::LINK:
+        hal::link_send(event.bytes.data(), event.bytes.size());
+        ++inputs;
+        break;
+      case trace::Event::EDGES:
+        if (event.index < NUM_SENSORS)
+          hal::edges(SENSORS[event.index].pin,
+                     static_cast<uint32_t>(event.value));
+        break;
+      case trace::Event::FREQUENCY:
+        if (event.index < NUM_SENSORS)
+          sources[event.index] = Source{event.value, now, 0};
+        break;
+    }
+  }
+};
+
+auto percentile(std::vector<uint32_t> &values, double fraction) -> uint32_t {
+  if (values.empty()) return 0;
+  auto index = static_cast<size_t>(fraction * (values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+auto distribution(const char *name, std::vector<uint32_t> &values) -> void {
+  printf("%-24s p50 %u p90 %u p99 %u max %u\n", name,
+         percentile(values, 0.5), percentile(values, 0.9),
+         percentile(values, 0.99), percentile(values, 1.0));
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <trace> [settle_ms]\n", argv[0]);
+    return 2;
+  }
+  std::ifstream file(argv[1]);
+  std::vector<trace::Event> events;
+  if (!file || !trace::read(file, events)) {
+    fprintf(stderr, "%s: can't read trace\n", argv[1]);
+    return 1;
+  }
+  uint64_t settle_us = (argc > 2) ? strtoull(argv[2], nullptr, 10) * 1000
+                                  : 1000000;
+
+  auto &framework = harness::framework();
+  Replay replay;
+  replay.start = time_us_64();
+  auto begin = Clock::now();
+  for (const auto &event : events) {
+    replay.run(framework, replay.start + event.us);
+    replay.apply(event, time_us_64());
+  }
+  auto last = events.empty() ? 0 : events.back().us;
+  auto end = replay.start + last + settle_us;
+  replay.run(framework, end);
+  auto wall = std::chrono::duration<double>(Clock::now() - begin).count();
+  auto simulated = static_cast<double>(end - replay.start) / 1e6;
+
+  printf("%-24s %zu\n", "events", events.size());
+  printf("%-24s %.3f s, %.0fx real time\n", "simulated", simulated,
+         simulated / wall);
+  printf("%-24s %.1f/s\n", "inputs", replay.inputs / wall);
+  printf("%-24s %zu, %.1f ns/pass\n", "passes", replay.pass_ns.size(),
+         wall * 1e9 / replay.pass_ns.size());
+  distribution("pass ns", replay.pass_ns);
+  distribution("latency us", replay.latency_us);
+  distribution("latency passes", replay.latency_passes);
+  distribution("latency ns", replay.latency_ns);
+  size_t unanswered = 0;
+  for (const auto &pending : replay.pending) unanswered += pending.size();
+  printf("%-24s %zu\n", "unanswered", unanswered);
+  const char *rings[] = {"api ring", "console ring"};
+  for (uint8_t channel = 0; channel < NUM_CHANNELS; ++channel) {
+    const auto &stats = framework.stats().channel(channel);
+    printf("%-24s high water %u dropped %u\n", rings[channel],
+           stats.high_water, stats.dropped);
+  }
+  auto &store = framework.store();
+  if (store.generation() == 0 && store.used() == FLASH_SECTOR_SIZE) {
+    printf("%-24s empty\n", "store used");
+  } else {
+    printf("%-24s %zu bytes\n", "store used", store.used());
+  }
+  auto &power = framework.power();
+  printf("%-24s %llu ms, %u wakes\n", "slowed",
+         static_cast<unsigned long long>(power.slow_us(time_us_64()) / 1000),
+         power.wakes());
+  printf("%-24s %llu bytes, checksum %016llx\n", "output",
+         static_cast<unsigned long long>(replay.output_bytes),
+         static_cast<unsigned long long>(replay.checksum));
+  return 0;
+}
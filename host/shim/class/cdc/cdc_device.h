@@ -0,0 +1,6 @@
+#ifndef HOST_SHIM_CLASS_CDC_CDC_DEVICE_H
+#define HOST_SHIM_CLASS_CDC_CDC_DEVICE_H
+
+#include "tusb.h"
+
+#endif  // HOST_SHIM_CLASS_CDC_CDC_DEVICE_H
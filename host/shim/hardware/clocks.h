@@ -0,0 +1,25 @@
+#ifndef HOST_SHIM_HARDWARE_CLOCKS_H
+#define HOST_SHIM_HARDWARE_CLOCKS_H
+
+#include "pico.h"
+
+enum clock_num_t { clk_gpout0 = 0, clk_ref = 4, clk_sys, clk_peri, clk_usb,
+                   clk_adc, clk_rtc, CLK_COUNT };
+using clock_handle_t = clock_num_t;
+
+constexpr uint32_t SYS_CLK_HZ = 125 * 1000 * 1000;
+constexpr uint32_t USB_CLK_HZ = 48 * 1000 * 1000;
+
+constexpr uint32_t CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLK_REF = 0;
+constexpr uint32_t CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX = 1;
+constexpr uint32_t CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS = 0;
+constexpr uint32_t CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB = 1;
+constexpr uint32_t CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLK_SYS = 0;
+constexpr uint32_t CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB = 2;
+
+auto clock_configure(clock_handle_t clock, uint32_t src, uint32_t auxsrc,
+                     uint32_t src_freq, uint32_t freq) -> bool;
+auto clock_stop(clock_handle_t clock) -> void;
+auto clock_get_hz(clock_handle_t clock) -> uint32_t;
+
+#endif  // HOST_SHIM_HARDWARE_CLOCKS_H
@@ -0,0 +1,43 @@
+#ifndef HOST_SHIM_HARDWARE_DMA_H
+#define HOST_SHIM_HARDWARE_DMA_H
+
+#include "pico.h"
+
+enum dma_channel_transfer_size { DMA_SIZE_8 = 0, DMA_SIZE_16, DMA_SIZE_32 };
+
+struct dma_channel_config {
+  uint dreq;
+  uint ring_bits;
+};
+
+// Addresses are pointer sized here, the firmware only reads the count.
+struct dma_channel_hw_t {
+  volatile uintptr_t read_addr;
+  volatile uintptr_t write_addr;
+  volatile uint32_t transfer_count;
+};
+
+auto dma_claim_unused_channel(bool required) -> int;
+auto dma_channel_get_default_config(uint channel) -> dma_channel_config;
+auto channel_config_set_transfer_data_size(
+    dma_channel_config *c, dma_channel_transfer_size size) -> void;
+auto channel_config_set_read_increment(dma_channel_config *c,
+                                       bool incr) -> void;
+auto channel_config_set_write_increment(dma_channel_config *c,
+                                        bool incr) -> void;
+auto channel_config_set_ring(dma_channel_config *c, bool write,
+                             uint size_bits) -> void;
+auto channel_config_set_dreq(dma_channel_config *c, uint dreq) -> void;
+auto dma_channel_configure(uint channel, const dma_channel_config *config,
+                           volatile void *write_addr,
+                           const volatile void *read_addr,
+                           uint transfer_count, bool trigger) -> void;
+auto dma_channel_is_busy(uint channel) -> bool;
+auto dma_channel_set_trans_count(uint channel, uint32_t trans_count,
+                                 bool trigger) -> void;
+auto dma_channel_transfer_from_buffer_now(uint channel,
+                                          const volatile void *read_addr,
+                                          uint32_t transfer_count) -> void;
+auto dma_channel_hw_addr(uint channel) -> dma_channel_hw_t *;
+
+#endif  // HOST_SHIM_HARDWARE_DMA_H
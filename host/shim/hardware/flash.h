@@ -0,0 +1,13 @@
+#ifndef HOST_SHIM_HARDWARE_FLASH_H
+#define HOST_SHIM_HARDWARE_FLASH_H
+
+#include "pico.h"
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+
+auto flash_range_erase(uint32_t flash_offs, size_t count) -> void;
+auto flash_range_program(uint32_t flash_offs, const uint8_t *data,
+                         size_t count) -> void;
+
+#endif  // HOST_SHIM_HARDWARE_FLASH_H
@@ -0,0 +1,28 @@
+#ifndef HOST_SHIM_HARDWARE_GPIO_H
+#define HOST_SHIM_HARDWARE_GPIO_H
+
+#include "pico.h"
+
+enum gpio_function { GPIO_FUNC_UART = 2, GPIO_FUNC_PWM = 4, GPIO_FUNC_SIO = 5 };
+enum gpio_irq_level {
+  GPIO_IRQ_LEVEL_LOW = 1,
+  GPIO_IRQ_LEVEL_HIGH = 2,
+  GPIO_IRQ_EDGE_FALL = 4,
+  GPIO_IRQ_EDGE_RISE = 8
+};
+
+auto gpio_init(uint gpio) -> void;
+auto gpio_set_dir(uint gpio, bool out) -> void;
+auto gpio_put(uint gpio, bool value) -> void;
+auto gpio_get(uint gpio) -> bool;
+auto gpio_init_mask(uint gpio_mask) -> void;
+auto gpio_set_dir_out_masked(uint32_t mask) -> void;
+auto gpio_put_masked(uint32_t mask, uint32_t value) -> void;
+auto gpio_get_all() -> uint32_t;
+auto gpio_set_function(uint gpio, gpio_function fn) -> void;
+auto gpio_set_irq_enabled(uint gpio, uint32_t events, bool enabled) -> void;
+auto gpio_add_raw_irq_handler(uint gpio, void (*handler)()) -> void;
+auto gpio_acknowledge_irq(uint gpio, uint32_t events) -> void;
+auto gpio_get_irq_event_mask(uint gpio) -> uint32_t;
+
+#endif  // HOST_SHIM_HARDWARE_GPIO_H
@@ -0,0 +1,15 @@
+#ifndef HOST_SHIM_HARDWARE_IRQ_H
+#define HOST_SHIM_HARDWARE_IRQ_H
+
+#include "pico.h"
+
+typedef void (*irq_handler_t)();
+
+#define PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY 0x80
+#define IO_IRQ_BANK0 13
+
+auto irq_add_shared_handler(uint num, irq_handler_t handler,
+                            uint8_t order_priority) -> void;
+auto irq_set_enabled(uint num, bool enabled) -> void;
+
+#endif  // HOST_SHIM_HARDWARE_IRQ_H
@@ -0,0 +1,25 @@
+#ifndef HOST_SHIM_HARDWARE_PLL_H
+#define HOST_SHIM_HARDWARE_PLL_H
+
+#include "pico.h"
+
+struct pll_hw_t {
+  volatile uint32_t cs;
+};
+using PLL = pll_hw_t *;
+
+extern pll_hw_t host_pll_sys;
+extern pll_hw_t host_pll_usb;
+#define pll_sys (&host_pll_sys)
+#define pll_usb (&host_pll_usb)
+
+constexpr uint PLL_SYS_REFDIV = 1;
+constexpr uint32_t PLL_SYS_VCO_FREQ_HZ = 1500 * 1000 * 1000;
+constexpr uint PLL_SYS_POSTDIV1 = 6;
+constexpr uint PLL_SYS_POSTDIV2 = 2;
+
+auto pll_init(PLL pll, uint ref_div, uint vco_freq, uint post_div1,
+              uint post_div2) -> void;
+auto pll_deinit(PLL pll) -> void;
+
+#endif  // HOST_SHIM_HARDWARE_PLL_H
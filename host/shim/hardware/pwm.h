@@ -0,0 +1,40 @@
+#ifndef HOST_SHIM_HARDWARE_PWM_H
+#define HOST_SHIM_HARDWARE_PWM_H
+
+#include "hardware/gpio.h"
+#include "pico.h"
+
+#define NUM_PWM_SLICES 8
+#define PWM_IRQ_WRAP 4
+
+enum pwm_clkdiv_mode {
+  PWM_DIV_FREE_RUNNING,
+  PWM_DIV_B_HIGH,
+  PWM_DIV_B_RISING,
+  PWM_DIV_B_FALLING
+};
+enum { PWM_CHAN_A = 0, PWM_CHAN_B = 1 };
+
+struct pwm_config {
+  uint32_t csr;
+  uint32_t div;
+  uint32_t top;
+};
+
+auto pwm_get_default_config() -> pwm_config;
+auto pwm_config_set_clkdiv_mode(pwm_config *c, pwm_clkdiv_mode mode) -> void;
+auto pwm_gpio_to_slice_num(uint gpio) -> uint;
+auto pwm_gpio_to_channel(uint gpio) -> uint;
+auto pwm_init(uint slice_num, pwm_config *c, bool start) -> void;
+auto pwm_set_enabled(uint slice_num, bool enabled) -> void;
+auto pwm_set_wrap(uint slice_num, uint16_t wrap) -> void;
+auto pwm_set_gpio_level(uint gpio, uint16_t level) -> void;
+auto pwm_set_chan_level(uint slice_num, uint chan, uint16_t level) -> void;
+auto pwm_set_both_levels(uint slice_num, uint16_t level_a,
+                         uint16_t level_b) -> void;
+auto pwm_get_counter(uint slice_num) -> uint16_t;
+auto pwm_clear_irq(uint slice_num) -> void;
+auto pwm_set_irq_enabled(uint slice_num, bool enabled) -> void;
+auto pwm_get_irq_status_mask() -> uint32_t;
+
+#endif  // HOST_SHIM_HARDWARE_PWM_H
@@ -0,0 +1,10 @@
+#ifndef HOST_SHIM_HARDWARE_REGS_ADDRESSMAP_H
+#define HOST_SHIM_HARDWARE_REGS_ADDRESSMAP_H
+
+#include <cstdint>
+
+// Flash is an array in hal.cpp, so XIP reads see what was programmed.
+extern uint8_t host_flash[];
+#define XIP_BASE (reinterpret_cast<uintptr_t>(host_flash))
+
+#endif  // HOST_SHIM_HARDWARE_REGS_ADDRESSMAP_H
@@ -0,0 +1,9 @@
+#ifndef HOST_SHIM_HARDWARE_SYNC_H
+#define HOST_SHIM_HARDWARE_SYNC_H
+
+#include "pico.h"
+
+auto save_and_disable_interrupts() -> uint32_t;
+auto restore_interrupts(uint32_t status) -> void;
+
+#endif  // HOST_SHIM_HARDWARE_SYNC_H
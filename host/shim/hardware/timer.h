@@ -0,0 +1,14 @@
+#ifndef HOST_SHIM_HARDWARE_TIMER_H
+#define HOST_SHIM_HARDWARE_TIMER_H
+
+#include "pico/types.h"
+
+typedef void (*hardware_alarm_callback_t)(uint alarm_num);
+
+auto hardware_alarm_claim_unused(bool required) -> int;
+auto hardware_alarm_set_callback(uint alarm_num,
+                                 hardware_alarm_callback_t callback) -> void;
+auto hardware_alarm_set_target(uint alarm_num, absolute_time_t t) -> bool;
+auto hardware_alarm_cancel(uint alarm_num) -> void;
+
+#endif  // HOST_SHIM_HARDWARE_TIMER_H
@@ -0,0 +1,19 @@
+#ifndef HOST_SHIM_HARDWARE_UART_H
+#define HOST_SHIM_HARDWARE_UART_H
+
+#include "pico.h"
+
+struct uart_hw_t {
+  volatile uint32_t dr;
+};
+struct uart_inst_t {
+  uart_hw_t hw;
+  uint index;
+};
+
+auto uart_get_instance(uint num) -> uart_inst_t *;
+auto uart_get_hw(uart_inst_t *uart) -> uart_hw_t *;
+auto uart_init(uart_inst_t *uart, uint baudrate) -> uint;
+auto uart_get_dreq(uart_inst_t *uart, bool is_tx) -> uint;
+
+#endif  // HOST_SHIM_HARDWARE_UART_H
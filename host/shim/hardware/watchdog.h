@@ -0,0 +1,12 @@
+#ifndef HOST_SHIM_HARDWARE_WATCHDOG_H
+#define HOST_SHIM_HARDWARE_WATCHDOG_H
+
+#include "pico.h"
+
+auto watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms) -> void;
+auto watchdog_enable(uint32_t delay_ms, bool pause_on_debug) -> void;
+auto watchdog_update() -> void;
+auto watchdog_caused_reboot() -> bool;
+auto watchdog_enable_caused_reboot() -> bool;
+
+#endif  // HOST_SHIM_HARDWARE_WATCHDOG_H
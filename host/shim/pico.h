@@ -0,0 +1,18 @@
+#ifndef HOST_SHIM_PICO_H
+#define HOST_SHIM_PICO_H
+
+// Host stand ins for the parts of the Pico SDK the firmware uses, enough to
+// build io/ and app/ natively. Behaviour lives in hal.cpp, see host/hal.h.
+#include "pico/types.h"
+
+#define __not_in_flash_func(f) f
+#define __time_critical_func(f) f
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+
+// Counted by hal.cpp so a simulation can tell the core went to sleep.
+void __wfe();
+inline void __sev() {}
+inline void __dmb() {}
+inline void tight_loop_contents() {}
+
+#endif  // HOST_SHIM_PICO_H
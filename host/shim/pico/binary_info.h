@@ -0,0 +1,8 @@
+#ifndef HOST_SHIM_PICO_BINARY_INFO_H
+#define HOST_SHIM_PICO_BINARY_INFO_H
+
+#define bi_decl(x)
+#define bi_1pin_with_name(pin, name) 0
+#define bi_2pins_with_func(pin0, pin1, func) 0
+
+#endif  // HOST_SHIM_PICO_BINARY_INFO_H
@@ -0,0 +1,8 @@
+#ifndef HOST_SHIM_PICO_BOOTROM_H
+#define HOST_SHIM_PICO_BOOTROM_H
+
+#include "pico.h"
+
+auto reset_usb_boot(uint32_t gpio_mask, uint32_t disable_mask) -> void;
+
+#endif  // HOST_SHIM_PICO_BOOTROM_H
@@ -0,0 +1,12 @@
+#ifndef HOST_SHIM_PICO_FLASH_H
+#define HOST_SHIM_PICO_FLASH_H
+
+#include "pico.h"
+
+#define PICO_OK 0
+
+auto flash_safe_execute(void (*func)(void *), void *param,
+                        uint32_t enter_exit_timeout_ms) -> int;
+auto flash_safe_execute_core_init() -> bool;
+
+#endif  // HOST_SHIM_PICO_FLASH_H
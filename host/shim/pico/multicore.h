@@ -0,0 +1,8 @@
+#ifndef HOST_SHIM_PICO_MULTICORE_H
+#define HOST_SHIM_PICO_MULTICORE_H
+
+#include "pico.h"
+
+auto multicore_launch_core1(void (*entry)()) -> void;
+
+#endif  // HOST_SHIM_PICO_MULTICORE_H
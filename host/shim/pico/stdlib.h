@@ -0,0 +1,7 @@
+#ifndef HOST_SHIM_PICO_STDLIB_H
+#define HOST_SHIM_PICO_STDLIB_H
+
+#include "hardware/gpio.h"
+#include "pico/time.h"
+
+#endif  // HOST_SHIM_PICO_STDLIB_H
@@ -0,0 +1,18 @@
+#ifndef HOST_SHIM_PICO_TIME_H
+#define HOST_SHIM_PICO_TIME_H
+
+#include "hardware/timer.h"
+#include "pico.h"
+
+auto time_us_64() -> uint64_t;
+auto time_us_32() -> uint32_t;
+auto sleep_ms(uint32_t ms) -> void;
+
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+auto add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data,
+                     bool fire_if_past) -> alarm_id_t;
+auto cancel_alarm(alarm_id_t alarm_id) -> bool;
+
+#endif  // HOST_SHIM_PICO_TIME_H
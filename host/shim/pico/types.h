@@ -0,0 +1,13 @@
+#ifndef HOST_SHIM_PICO_TYPES_H
+#define HOST_SHIM_PICO_TYPES_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+inline auto from_us_since_boot(uint64_t us) -> absolute_time_t { return us; }
+
+#endif  // HOST_SHIM_PICO_TYPES_H
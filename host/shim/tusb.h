@@ -0,0 +1,18 @@
+#ifndef HOST_SHIM_TUSB_H
+#define HOST_SHIM_TUSB_H
+
+#include "pico.h"
+
+#define CFG_TUD_CDC 2
+
+auto tusb_init() -> bool;
+auto tud_task() -> void;
+auto tud_task_event_ready() -> bool;
+auto tud_cdc_n_available(uint8_t itf) -> uint32_t;
+auto tud_cdc_n_read(uint8_t itf, void *buffer, uint32_t bufsize) -> uint32_t;
+auto tud_cdc_n_write_available(uint8_t itf) -> uint32_t;
+auto tud_cdc_n_write(uint8_t itf, const void *buffer, uint32_t bufsize)
+    -> uint32_t;
+auto tud_cdc_n_write_flush(uint8_t itf) -> uint32_t;
+
+#endif  // HOST_SHIM_TUSB_H
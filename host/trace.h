@@ -0,0 +1,131 @@
+#ifndef HOST_TRACE_H
+#define HOST_TRACE_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <istream>
+#include <string>
+#include <vector>
+
+// Recorded device inputs, one event a line at its time in us from the start:
+//
+//   # comment
+//   <us> u<channel> <bytes>   bytes from the host on a usb cdc channel
+//   <us> l <bytes>            bytes arriving on the uart link
+//   <us> e<sensor> <count>    that many rising edges on a sensor at once
+//   <us> f<sensor> <mhz>      a sensor's pulse rate in mHz from then on
+//
+// Bytes are the rest of the line, with \r, \n, \\ and \xhh escapes. Times
+// don't go backwards.
+namespace trace {
+
+struct Event {
+  enum Type : char { USB = 'u', LINK = 'l', EDGES = 'e', FREQUENCY = 'f' };
+  uint64_t us;
+  Type type;
+  uint8_t index;  // Channel or sensor.
+  uint64_t value;
+  std::string bytes;
+};
+
+inline auto escape(const char *data, size_t length) -> std::string {
+  static const char hex[] = "0123456789abcdef";
+  std::string result;
+  for (size_t i = 0; i < length; ++i) {
+    auto c = static_cast<unsigned char>(data[i]);
+    if (c == '\r') {
+      result += "\\r";
+    } else if (c == '\n') {
+      result += "\\n";
+    } else if (c == '\\') {
+      result += "\\\\";
+    } else if (c < ' ' || c > '~') {
+      result += "\\x";
+      result += hex[c >> 4];
+      result += hex[c & 15];
+    } else {
+      result += static_cast<char>(c);
+    }
+  }
+  return result;
+}
+
+inline auto unescape(const std::string &text, std::string &bytes) -> bool {
+  bytes.clear();
+  for (size_t i = 0; i < text.size(); ++i) {
+    if (text[i] != '\\') {
+      bytes += text[i];
+    } else if (++i == text.size()) {
+      return false;
+    } else if (text[i] == 'r') {
+      bytes += '\r';
+    } else if (text[i] == 'n') {
+      bytes += '\n';
+    } else if (text[i] == '\\') {
+      bytes += '\\';
+    } else if (text[i] == 'x' && i + 2 < text.size() &&
+               isxdigit(text[i + 1]) && isxdigit(text[i + 2])) {
+      bytes += static_cast<char>(strtoul(text.substr(i + 1, 2).c_str(),
+                                         nullptr, 16));
+      i += 2;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Reports the first bad line on stderr, leaving events empty.
+inline auto read(std::istream &in, std::vector<Event> &events) -> bool {
+  events.clear();
+  std::string line;
+  for (size_t number = 1; std::getline(in, line); ++number) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+    auto fail = [&] {
+      fprintf(stderr, "line %zu: bad event '%s'\n", number, line.c_str());
+      events.clear();
+      return false;
+    };
+    char *end = nullptr;
+    auto event = Event{strtoull(line.c_str(), &end, 10), Event::USB, 0, 0, {}};
+    if (end == line.c_str() || *end != ' ') return fail();
+    auto type = *++end;
+    if (type == '\0') return fail();
+    unsigned long index = 0;
+    if (isdigit(*++end)) index = strtoul(end, &end, 10);
+    if (index > UINT8_MAX || (*end != ' ' && *end != '\0')) return fail();
+    auto rest = (*end == ' ') ? std::string(end + 1) : std::string{};
+    event.index = static_cast<uint8_t>(index);
+    if (type == Event::USB || type == Event::LINK) {
+      if (!unescape(rest, event.bytes)) return fail();
+    } else if (type == Event::EDGES || type == Event::FREQUENCY) {
+      event.value = strtoull(rest.c_str(), &end, 10);
+      if (!isdigit(rest[0]) || *end != '\0') return fail();
+    } else {
+      return fail();
+    }
+    event.type = static_cast<Event::Type>(type);
+    if (!events.empty() && event.us < events.back().us) return fail();
+    events.push_back(std::move(event));
+  }
+  return true;
+}
+
+inline auto write(FILE *out, const Event &event) -> void {
+  fprintf(out, "%llu %c", static_cast<unsigned long long>(event.us),
+          event.type);
+  if (event.type != Event::LINK) fprintf(out, "%u", event.index);
+  if (event.type == Event::USB || event.type == Event::LINK) {
+    fprintf(out, " %s\n",
+            escape(event.bytes.data(), event.bytes.size()).c_str());
+  } else {
+    fprintf(out, " %llu\n", static_cast<unsigned long long>(event.value));
+  }
+}
+
+}  // namespace trace
+
+#endif  // HOST_TRACE_H
@@ -0,0 +1,38 @@
+#ifndef IO_BUFFER_SINK_H
+#define IO_BUFFER_SINK_H
+
+#include <cstddef>
+#include <cstring>
+
+#include "io/format.h"
+
+// Fixed buffer for text formatted once and sent many times. Output that does
+// not fit is dropped and print() returns false.
+template <size_t size>
+class BufferSink {
+ public:
+  BufferSink() : length_{0} {}
+
+  auto clear() -> void { length_ = 0; }
+
+  auto write(const char *data, size_t length) -> size_t {
+    if (length > size - length_) length = size - length_;
+    memcpy(&buffer_[length_], data, length);
+    length_ += length;
+    return length;
+  }
+
+  template <FormatString format, typename... Args>
+  auto print(Args... args) -> bool {
+    return Format::write<format>(*this, args...);
+  }
+
+  auto data() const -> const char * { return buffer_; }
+  auto length() const -> size_t { return length_; }
+
+ private:
+  char buffer_[size];
+  size_t length_;
+};
+
+#endif  // IO_BUFFER_SINK_H
@@ -0,0 +1,68 @@
+#ifndef IO_CHANNELS_H
+#define IO_CHANNELS_H
+
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+// A fixed set of channels of possibly different types, typically built from a
+// constexpr table of pins. for_each() is unrolled at compile time and at()
+// reaches a channel by run time index through a jump table generated for
+// each use, so there are no virtual calls and no per channel code.
+//
+//   valves.at(target, [now](auto &valve) { valve.pulse(10, now); });
+template <typename... Channel>
+class Channels {
+ public:
+  static constexpr size_t size = sizeof...(Channel);
+
+  template <size_t index>
+  auto get() -> auto & {
+    return std::get<index>(channels_);
+  }
+
+  // visit(channel, index) for each channel in order, index is a
+  // std::integral_constant so can be used at compile time too.
+  template <typename Visit>
+  auto for_each(Visit &&visit) -> void {
+    for_each(visit, std::index_sequence_for<Channel...>{});
+  }
+
+  // visit(channel) for the channel at index, which must be less than size.
+  template <typename Visit>
+  auto at(size_t index, Visit &&visit) -> decltype(auto) {
+    return at(index, visit, std::index_sequence_for<Channel...>{});
+  }
+
+ private:
+  using Tuple = std::tuple<Channel...>;
+
+  template <typename Visit, size_t... I>
+  auto for_each(Visit &visit, std::index_sequence<I...>) -> void {
+    (visit(std::get<I>(channels_), std::integral_constant<size_t, I>{}), ...);
+  }
+
+  template <typename Visit, size_t... I>
+  auto at(size_t index, Visit &visit, std::index_sequence<I...>)
+      -> decltype(auto) {
+    using Result = decltype(visit(std::get<0>(channels_)));
+    using Call = Result (*)(Tuple &, Visit &);
+    static constexpr Call table[] = {
+        [](Tuple &channels, Visit &visit) -> Result {
+          return visit(std::get<I>(channels));
+        }...};
+    return table[index](channels_, visit);
+  }
+
+  Tuple channels_;
+};
+
+template <template <size_t> typename Channel, size_t... I>
+auto channels_of(std::index_sequence<I...>) -> Channels<Channel<I>...>;
+
+// Channels with one Channel<I> per index.
+template <template <size_t> typename Channel, size_t count>
+using ChannelsOf =
+    decltype(channels_of<Channel>(std::make_index_sequence<count>{}));
+
+#endif  // IO_CHANNELS_H
@@ -1,10 +1,16 @@
 #ifndef IO_CONSOLE_H
 #define IO_CONSOLE_H
 
+#include <algorithm>
+#include <array>
 #include <cstdarg>
-#include <functional>
+#include <string_view>
 
-#include "io/conversion.h"
+#include "io/ring_sink.h"
+
+#ifndef CONSOLE_OUTPUT_BUFFER_SIZE
+#define CONSOLE_OUTPUT_BUFFER_SIZE 2048
+#endif
 
 class Console {
   using FORMAT = const char *;
@@ -28,12 +34,19 @@ class Console {
     CURSOR_RIGHT,
     CURSOR_HOME,
     CURSOR_END,
+    HISTORY_BACK,
+    HISTORY_FORWARD,
     PROCESS
   };
 
   struct Parameter {
     size_t size;
     const char *token;
+
+    // The whole token as a number, false if it isn't one or is out of range.
+    auto to_unsigned(uint32_t &value, unsigned base = 0) const -> bool;
+    auto to_signed(int32_t &value, unsigned base = 0) const -> bool;
+    auto to_fixed(unsigned decimals, int32_t &value) const -> bool;
   };
 
   struct CommandLine {
@@ -44,9 +57,47 @@ class Console {
 
   struct Command {
     const char *name;
-    std::function<void(Console &, CommandLine &)> handler;
+    void (*handler)(Console &, CommandLine &);
+  };
+
+  // Commands sorted by name, built at compile time with sorted().
+  struct Commands {
+    const Command *commands = nullptr;
+    size_t size = 0;
   };
 
+  // The table sorted for find_command(), with a check for duplicates.
+  //
+  //   constexpr Console::Command list[] = {{"help", help}, ...};
+  //   constexpr auto table = Console::sorted(list);
+  //   static_assert(Console::unique(table));
+  template <size_t size>
+  static constexpr auto sorted(const Command (&commands)[size])
+      -> std::array<Command, size> {
+    std::array<Command, size> result{};
+    std::copy(commands, commands + size, result.begin());
+    std::sort(result.begin(), result.end(),
+              [](const Command &a, const Command &b) {
+                return std::string_view{a.name} < std::string_view{b.name};
+              });
+    return result;
+  }
+  template <size_t size>
+  static constexpr auto unique(const std::array<Command, size> &commands)
+      -> bool {
+    for (size_t i = 1; i < size; ++i) {
+      if (std::string_view{commands[i - 1].name} ==
+          std::string_view{commands[i].name})
+        return false;
+    }
+    return true;
+  }
+  template <size_t size>
+  static constexpr auto table(const std::array<Command, size> &commands)
+      -> Commands {
+    return Commands{commands.data(), size};
+  }
+
   class EditBuffer {
    public:
     static constexpr size_t SIZE = 120;
@@ -59,7 +110,26 @@ class Console {
     size_t end;
   };
 
-  Console(const char *banner, const Command *commands);
+  // The last few command lines, recalled with up and down. Position 0 is the
+  // line being edited, 1 the most recent command and so on.
+  class History {
+   public:
+    static constexpr size_t SIZE = 8;
+
+    History() : next{0}, count{0}, position{0}, pending{} {}
+
+    auto add(const char *line, size_t length) -> void;
+    auto line(size_t position) const -> const EditBuffer &;
+
+    EditBuffer lines[SIZE];
+    size_t next;
+    size_t count;
+    size_t position;
+    // What was being typed before recalling a line.
+    EditBuffer pending;
+  };
+
+  Console(const char *banner, Commands commands);
 
   auto read_buffer() -> std::pair<uint8_t *, size_t>;
   auto read_done(size_t length) -> void;
@@ -67,20 +137,31 @@ class Console {
   auto write_done(size_t length) -> void;
 
   auto putc(char c) -> bool;
+  auto write(const char *data, size_t length) -> size_t;
   auto printf(FORMAT format...) -> int;
   auto vprintf(FORMAT format, va_list args) -> int;
+  auto output() const -> const auto & { return output_; }
+  // printf with the format specialised at compile time.
+  template <FormatString format, typename... Args>
+  auto print(Args... args) -> bool {
+    return output_.template print<format>(args...);
+  }
 
  private:
-  static constexpr size_t OUTPUT_BUFFER_SIZE = 2048;
+  static constexpr size_t OUTPUT_BUFFER_SIZE = CONSOLE_OUTPUT_BUFFER_SIZE;
   static constexpr size_t RX_BUFFER_SIZE = 64 + 1;
+  static constexpr char PROMPT[] = "GH> ";
 
-  static char output_buffer_[OUTPUT_BUFFER_SIZE];
+  static RingSink<OUTPUT_BUFFER_SIZE> output_;
   static uint8_t rx_buffer_[RX_BUFFER_SIZE];
   static EditBuffer edit_;
-  static Conversion conversion_;
+  static History history_;
   static CommandLine command_line_;
 
   auto edit(KeyAction action, char c) -> bool;
+  auto recall(size_t position) -> void;
+  auto redraw(size_t from, size_t old_end) -> void;
+  auto move_cursor() -> void;
   auto tokenise() -> void;
   auto find_command(Parameter &first) -> const Command *;
   auto parse(char c) -> KeyAction;
@@ -88,11 +169,9 @@ class Console {
   auto parse_escape_sequence(char c) -> KeyAction;
 
   const char *banner_;
-  const Command *commands_;
+  Commands commands_;
 
   ParseState parse_state_;
-  size_t tx_index_;
-  size_t tx_sent_;
 };
 
 #endif  // IO_CONSOLE_H
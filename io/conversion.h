@@ -22,12 +22,65 @@ class Conversion {
     STRING,
     POINTER
   };
+  // Fully parsed conversion specification.
+  struct Spec {
+    bool left_justified = false;
+    bool output_sign = false;
+    bool pad_positive = false;
+    bool alternate = false;
+    bool upper_case = false;
+    bool force_exponent = false;
+    bool dynamic = false;
+    uint8_t precision = 1;
+    uint8_t base = 0;
+    uint8_t width = 1;
+    char fill = ' ';
+  };
+
+  // Parse the conversion after a '%', usable at compile time.
+  static constexpr auto parse(FORMAT &format, Spec &spec) -> Type;
+
+  enum class Status : uint8_t { OK, EMPTY, INVALID, RANGE };
+
+  // Text to number over [scan, end). Base 0 detects a 0x, 0b or 0o prefix
+  // and is otherwise decimal. Parsing stops at the first character that isn't
+  // part of the number and scan is left there.
+  static auto to_unsigned(const char *&scan, const char *end, uint32_t &value,
+                          unsigned base = 0) -> Status;
+  static auto to_signed(const char *&scan, const char *end, int32_t &value,
+                        unsigned base = 0) -> Status;
+  // Decimal fixed point, "-1.235" with 2 decimals gives -124.
+  static auto to_fixed(const char *&scan, const char *end, unsigned decimals,
+                       int32_t &value) -> Status;
+  static auto to_double(const char *&scan, const char *end,
+                        double &value) -> Status;
+
+  // Nul terminated versions returning 0 when there is no number.
   static auto to_signed_int(const char *start, unsigned base = 10) -> int;
   static auto to_unsigned_int(const char *start,
                               unsigned base = 10) -> unsigned;
   static auto to_double(const char *start) -> double;
 
+  // Building blocks for parsers fed a character at a time.
+  // The value of a digit in any base up to 36, or NOT_A_DIGIT.
+  static constexpr unsigned NOT_A_DIGIT = 36;
+  static constexpr auto digit(char c) -> unsigned {
+    unsigned value = static_cast<unsigned>(c - '0');
+    if (value < 10) return value;
+    value = static_cast<unsigned>((c | 0x20) - 'a');
+    return (value < 26) ? value + 10 : NOT_A_DIGIT;
+  }
+  // value = value * base + digit, false if that overflows.
+  static constexpr auto accumulate(uint32_t &value, unsigned digit,
+                                   unsigned base) -> bool {
+    auto next = (static_cast<uint64_t>(value) * base) + digit;
+    if (next > UINT32_MAX) return false;
+    value = static_cast<uint32_t>(next);
+    return true;
+  }
+
   auto reset() -> void;
+  auto apply(const Spec &spec) -> void;
   auto parse(FORMAT &format) -> Type;
   auto from_character(long long value) -> const char *;
   auto from_signed_int(long long value) -> const char *;
@@ -37,12 +90,15 @@ class Conversion {
 
  private:
   static constexpr size_t CONVERSION_BUFFER_SIZE = 120;
+  static constexpr uint8_t MAX_PRECISION = 15;
+  static constexpr uint8_t MAX_WIDTH = 63;
 
   auto from_int_(bool negative, unsigned long long value) -> const char *;
-  auto convert_lower_(size_t index, unsigned long long value,
-                      unsigned base) -> int;
-  auto convert_upper_(size_t index, unsigned long long value,
-                      unsigned base) -> int;
+  auto finish_double_(bool negative, const char *body, size_t length,
+                      bool finite) -> const char *;
+  // Digits of value ending at end, returning the first.
+  static auto convert_(char *end, unsigned long long value, unsigned base,
+                       bool upper_case) -> char *;
 
   unsigned left_justified_ : 1;
   unsigned output_sign_ : 1;
@@ -58,4 +114,140 @@ class Conversion {
   char buffer_[CONVERSION_BUFFER_SIZE];
 };
 
+constexpr auto Conversion::parse(FORMAT &format, Spec &spec) -> Type {
+  spec = Spec{};
+  auto c = *format++;
+  // Flags, in any order.
+  for (;; c = *format++) {
+    if (c == '-')
+      spec.left_justified = true;
+    else if (c == '+')
+      spec.output_sign = true;
+    else if (c == ' ')
+      spec.pad_positive = true;
+    else if (c == '#')
+      spec.alternate = true;
+    else if (c == '0')
+      spec.fill = '0';
+    else
+      break;
+  }
+  int width = -1;
+  if (c >= '1' && c <= '9') {
+    width = 0;
+    while (c >= '0' && c <= '9') {
+      width = (width * 10) + (c - '0');
+      c = *format++;
+    }
+    if (width > MAX_WIDTH) width = MAX_WIDTH;
+  }
+  int precision = -1;
+  if (c == '.') {
+    precision = 0;
+    c = *format++;
+    while (c >= '0' && c <= '9') {
+      precision = (precision * 10) + (c - '0');
+      c = *format++;
+    }
+    if (precision > MAX_PRECISION) precision = MAX_PRECISION;
+  }
+  bool is_long = false;
+  bool is_long_long = false;
+  if (c == 'l' || c == 'L') {
+    is_long = true;
+    c = *format++;
+    if (c == 'l') {
+      is_long_long = true;
+      c = *format++;
+    }
+  } else if (c == 'h' || c == 'j' || c == 'z' || c == 't') {
+    // ignore
+    c = *format++;
+    if (c == 'h') c = *format++;
+  }
+  if (c == '\0') {
+    // Leave format on the terminator.
+    --format;
+    return Type::UNKNOWN;
+  }
+  bool is_unsigned = true;
+  if (c == '%')
+    return Type::PERCENT;
+  else if (c == 'c')
+    return Type::CHARACTER;
+  else if (c == 's') {
+    spec.width = (width > 0) ? width : 0;
+    spec.precision = (precision > 0) ? precision : 0;
+    return Type::STRING;
+    // Integer conversions
+  } else if (c == 'p') {
+    spec = Spec{};
+    spec.base = 16;
+    spec.width = 8;
+    spec.upper_case = true;
+    return Type::POINTER;
+  } else if (c == 'd' || c == 'i') {
+    is_unsigned = false;
+    spec.base = 10;
+  } else if (c == 'u')
+    spec.base = 10;
+  else if (c == 'o')
+    spec.base = 8;
+  else if (c == 'b')
+    spec.base = 2;
+  else if (c == 'X') {
+    spec.upper_case = true;
+    spec.base = 16;
+  } else if (c == 'x')
+    spec.base = 16;
+  if (spec.base != 0) {
+    spec.width = (width < 0) ? 1 : width;
+    spec.precision = (precision < 0) ? 1 : precision;
+    if (is_unsigned) {
+      if (is_long_long) return Type::LONG_LONG_UNSIGNED_INT;
+      if (is_long) return Type::LONG_UNSIGNED_INT;
+      return Type::UNSIGNED_INT;
+    } else {
+      if (is_long_long) return Type::LONG_LONG_SIGNED_INT;
+      if (is_long) return Type::LONG_SIGNED_INT;
+      return Type::SIGNED_INT;
+    }
+  }
+  // Floating point conversions.
+  spec.base = 10;
+  spec.width = (width < 0) ? 1 : width;
+  spec.precision = (precision < 0) ? 6 : precision;
+  if (c == 'f')
+    return Type::DOUBLE;
+  else if (c == 'F') {
+    spec.upper_case = true;
+    return Type::DOUBLE;
+  } else if (c == 'e') {
+    spec.force_exponent = true;
+    return Type::DOUBLE;
+  } else if (c == 'E') {
+    spec.force_exponent = true;
+    spec.upper_case = true;
+    return Type::DOUBLE;
+  } else if (c == 'a' || c == 'A') {
+    // Without a precision show as many digits as it takes to be exact.
+    if (precision < 0) {
+      spec.precision = 13;
+      spec.dynamic = true;
+    }
+    spec.base = 16;
+    spec.force_exponent = true;
+    spec.upper_case = c == 'A';
+    return Type::DOUBLE;
+  } else if (c == 'g') {
+    spec.dynamic = true;
+    return Type::DOUBLE;
+  } else if (c == 'G') {
+    spec.dynamic = true;
+    spec.upper_case = true;
+    return Type::DOUBLE;
+  }
+  return Type::UNKNOWN;
+}
+
 #endif  // IO_CONVERSION_Honce
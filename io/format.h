@@ -0,0 +1,184 @@
+#ifndef IO_FORMAT_H
+#define IO_FORMAT_H
+
+#include <array>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "io/conversion.h"
+
+// A string literal usable as a template parameter.
+template <size_t N>
+struct FormatString {
+  constexpr FormatString(const char (&str)[N]) {
+    for (size_t i = 0; i < N; ++i) value[i] = str[i];
+  }
+  char value[N];
+};
+
+// The printf engine shared by every output.
+// vwrite() is the run time version, parsing the format as it goes. write() is
+// specialised at compile time: the format literal is split into literal spans
+// and fully parsed conversions, so a call is straight line code writing each
+// span and converted argument to the sink. Argument count and types are
+// checked against the format when compiling.
+//
+//   Format::write<"v%d:%s\r\n">(sink, 1, "on");
+//
+// A Sink is anything with write(const char *data, size_t length) -> size_t.
+// All output shares one Conversion so this must only be used from one core.
+class Format {
+  using FORMAT = const char *;
+
+ public:
+  struct Writer {
+    void *context;
+    size_t (*write)(void *context, const char *data, size_t length);
+  };
+
+  static auto vwrite(const Writer &writer, FORMAT format,
+                     va_list args) -> int;
+
+  template <FormatString format, typename Sink, typename... Args>
+  static auto write(Sink &sink, Args... args) -> bool {
+    using Parts = Compiled<format>;
+    static_assert(Parts::valid, "Bad conversion in format string");
+    static_assert(Parts::arguments == sizeof...(Args),
+                  "Wrong number of arguments for format string");
+    auto values = std::make_tuple(args...);
+    return emit<format>(sink, conversion_, values,
+                        std::make_index_sequence<Parts::size>{});
+  }
+
+ private:
+  static Conversion conversion_;
+
+  struct Segment {
+    bool literal = true;
+    Conversion::Type type = Conversion::Type::UNKNOWN;
+    Conversion::Spec spec = {};
+    size_t start = 0;
+    size_t length = 0;
+    size_t argument = 0;
+  };
+
+  struct Summary {
+    bool valid = true;
+    size_t size = 0;
+    size_t arguments = 0;
+  };
+
+  // One pass used both to count and to fill in the segments.
+  template <typename Visit>
+  static constexpr auto split(const char *format, Visit visit) -> Summary {
+    Summary summary;
+    auto scan = format;
+    while (*scan != '\0') {
+      if (*scan == '%') {
+        auto start = ++scan;
+        Segment segment;
+        segment.type = Conversion::parse(scan, segment.spec);
+        if (segment.type == Conversion::Type::UNKNOWN) {
+          summary.valid = false;
+          break;
+        }
+        if (segment.type == Conversion::Type::PERCENT) {
+          // Output the second '%' as a literal.
+          segment.start = static_cast<size_t>(start - format);
+          segment.length = 1;
+        } else {
+          segment.literal = false;
+          segment.argument = summary.arguments++;
+        }
+        visit(summary.size++, segment);
+      } else {
+        Segment segment;
+        segment.start = static_cast<size_t>(scan - format);
+        while (*scan != '\0' && *scan != '%') ++scan;
+        segment.length = static_cast<size_t>(scan - format) - segment.start;
+        visit(summary.size++, segment);
+      }
+    }
+    return summary;
+  }
+
+  template <FormatString format>
+  struct Compiled {
+    static constexpr Summary summary =
+        split(format.value, [](size_t, const Segment &) {});
+    static constexpr bool valid = summary.valid;
+    static constexpr size_t size = summary.size;
+    static constexpr size_t arguments = summary.arguments;
+    static constexpr std::array<Segment, size> segments = [] {
+      std::array<Segment, size> result{};
+      split(format.value, [&result](size_t index, const Segment &segment) {
+        result[index] = segment;
+      });
+      return result;
+    }();
+  };
+
+  template <FormatString format, typename Sink, typename Tuple, size_t... I>
+  static auto emit(Sink &sink, Conversion &conversion, Tuple &values,
+                   std::index_sequence<I...>) -> bool {
+    bool room = true;
+    ((room = room && emit_segment<format, I>(sink, conversion, values)), ...);
+    return room;
+  }
+
+  template <FormatString format, size_t I, typename Sink, typename Tuple>
+  static auto emit_segment(Sink &sink, Conversion &conversion,
+                           Tuple &values) -> bool {
+    constexpr auto &segment = Compiled<format>::segments[I];
+    if constexpr (segment.literal) {
+      return sink.write(&format.value[segment.start], segment.length) ==
+             segment.length;
+    } else {
+      conversion.apply(segment.spec);
+      auto buffer = convert<segment.type>(
+          conversion, std::get<segment.argument>(values));
+      if (buffer == nullptr) return true;
+      auto length = strlen(buffer);
+      return sink.write(buffer, length) == length;
+    }
+  }
+
+  template <Conversion::Type type, typename T>
+  static auto convert(Conversion &conversion, T value) -> const char * {
+    using Type = Conversion::Type;
+    if constexpr (type == Type::CHARACTER) {
+      static_assert(std::is_integral_v<T>, "%c needs an integer");
+      return conversion.from_character(value);
+    } else if constexpr (type == Type::SIGNED_INT ||
+                         type == Type::LONG_SIGNED_INT ||
+                         type == Type::LONG_LONG_SIGNED_INT) {
+      static_assert(std::is_integral_v<T> || std::is_enum_v<T>,
+                    "%d needs an integer");
+      return conversion.from_signed_int(static_cast<long long>(value));
+    } else if constexpr (type == Type::UNSIGNED_INT ||
+                         type == Type::LONG_UNSIGNED_INT ||
+                         type == Type::LONG_LONG_UNSIGNED_INT) {
+      static_assert(std::is_integral_v<T> || std::is_enum_v<T>,
+                    "%u/%x needs an integer");
+      return conversion.from_unsigned_int(
+          static_cast<unsigned long long>(value));
+    } else if constexpr (type == Type::POINTER) {
+      static_assert(std::is_pointer_v<T>, "%p needs a pointer");
+      return conversion.from_unsigned_int(reinterpret_cast<uintptr_t>(value));
+    } else if constexpr (type == Type::DOUBLE) {
+      static_assert(std::is_arithmetic_v<T>, "%f needs a number");
+      return conversion.from_double(static_cast<double>(value));
+    } else {
+      static_assert(std::is_convertible_v<T, const char *>,
+                    "%s needs a string");
+      return conversion.from_string(value);
+    }
+  }
+};
+
+#endif  // IO_FORMAT_H
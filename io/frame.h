@@ -0,0 +1,46 @@
+#ifndef IO_FRAME_H
+#define IO_FRAME_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Length prefixed, crc checked binary frames.
+//   SYNC LENGTH TYPE PAYLOAD[LENGTH] CRC_LO CRC_HI
+// The crc is CRC-16/CCITT-FALSE over LENGTH, TYPE and the PAYLOAD.
+class Frame {
+ public:
+  static constexpr uint8_t SYNC = 0xa5;
+  static constexpr size_t MAX_PAYLOAD = 128;
+  static constexpr size_t OVERHEAD = 5;
+
+  enum class State { SYNC, LENGTH, TYPE, PAYLOAD, CRC_LOW, CRC_HIGH };
+
+  Frame() : crc_errors_{0} { reset(); }
+
+  static auto crc16(uint16_t crc, const uint8_t *data,
+                    size_t length) -> uint16_t;
+  // Encode a frame into out, which must hold length + OVERHEAD bytes.
+  static auto encode(uint8_t type, const void *payload, size_t length,
+                     uint8_t *out) -> size_t;
+
+  auto reset() -> void;
+  // Feed one byte, true when a complete frame with a good crc is held.
+  auto parse(uint8_t c) -> bool;
+
+  auto type() const { return type_; }
+  auto length() const { return length_; }
+  auto payload() const -> const uint8_t * { return payload_; }
+  auto crc_errors() const { return crc_errors_; }
+
+ private:
+  State state_;
+  uint8_t type_;
+  uint8_t length_;
+  uint8_t index_;
+  uint16_t crc_;
+  uint16_t received_crc_;
+  uint16_t crc_errors_;
+  uint8_t payload_[MAX_PAYLOAD];
+};
+
+#endif  // IO_FRAME_H
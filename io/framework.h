@@ -2,32 +2,59 @@
 #define IO_FRAMEWORK_H
 
 #include "io/console.h"
+#include "io/power.h"
+#include "io/scheduler.h"
+#include "io/stats.h"
+#include "io/store.h"
 
 class AppApi;
 class Framework {
  public:
   static Framework& get(const char* banner = nullptr,
-                        const Console::Command* commands = nullptr);
+                        Console::Commands commands = {});
 
-  Framework(const char* banner, const Console::Command* commands)
+  Framework(const char* banner, Console::Commands commands)
       : app_{nullptr}, console_{banner, commands} {
     console_.printf("Framework constructed");
   }
 
   auto init() -> void;
   auto periodic() -> void;
+  auto wait() -> void;
 
   // Accessors
   auto app(AppApi* app) { app_ = app; }
   auto app() { return app_; }
   auto& console() { return console_; }
+  auto& power() { return power_; }
+  auto& scheduler() { return scheduler_; }
+  auto& store() { return store_; }
+  auto& stats() { return stats_; }
 
- private:
+ public:
   static constexpr uint8_t API_USB_CH = 0;
   static constexpr uint8_t DEBUG_USB_CH = 1;
 
+  // Output is left in a cdc fifo, to go out with whatever follows, until it
+  // ends the reply to some input or there are bytes of it or the oldest has
+  // waited us. Full packets are always sent straight away.
+  struct Flush {
+    uint32_t bytes;
+    uint32_t us;
+  };
+  static constexpr Flush API_FLUSH = {64, 2000};
+  static constexpr Flush DEBUG_FLUSH = {64, 10000};
+
+ private:
+
+  auto busy() -> bool;
+
   AppApi* app_;
   Console console_;
+  Power power_;
+  Scheduler scheduler_;
+  Store store_;
+  Stats stats_;
 };
 
 #endif  // IO_FRAMEWORK_H
@@ -1,52 +1,180 @@
 #ifndef IO_FREQ_H
 #define IO_FREQ_H
 
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
 #include "hardware/pwm.h"
+#include "hardware/sync.h"
 #include "pico/time.h"
 
-template <uint pin, uint64_t sample_seconds>
+// PWM wrap counts shared by every Freq, extending the 16 bit slice counters
+// to 32 bits from the PWM_IRQ_WRAP interrupt.
+class FreqWraps {
+ public:
+  static auto enable(uint slice) -> void;
+  // Counter extended by the wraps, call with interrupts disabled or from an
+  // interrupt handler.
+  static auto count(uint slice) -> uint32_t;
+
+ private:
+  static auto handler() -> void;
+};
+
+// Frequency counter on a PWM B pin.
+// The slice counts rising edges continuously and is never stopped, so no
+// edges are lost between windows. Each window_ms the count and the time are
+// read together and the frequency is the count over the actual elapsed time,
+// so the loop's timing jitter doesn't matter. Below RECIPROCAL_ENTER_MHZ an
+// edge interrupt timestamps edges too and the frequency comes from the time
+// between the first and last edges seen, which is far more precise than
+// counting when there are only a few edges a window.
+// Reading is non destructive, each window bumps sequence() so any number of
+// consumers can tell for themselves whether they have seen the latest value.
+// window_ms is only the default, set_window() changes it at run time.
+template <uint pin, uint32_t window_ms>
 class Freq {
  public:
-  Freq() : next_{0}, value_{0}, updated_{false} {}
+  // Millihertz.
+  static constexpr uint32_t RECIPROCAL_ENTER_MHZ = 1000 * 1000;
+  static constexpr uint32_t RECIPROCAL_LEAVE_MHZ = 2000 * 1000;
+
+  Freq()
+      : window_us_{window_ms * 1000ULL},
+        next_{0},
+        window_time_{0},
+        window_count_{0},
+        last_edge_time_{0},
+        last_edge_count_{0},
+        value_{0},
+        sequence_{0},
+        reciprocal_{false},
+        edge_valid_{false} {}
 
   constexpr auto get_pin() { return pin; }
 
   auto init() {
     // Only the PWM B pins can be used as inputs.
     assert(pwm_gpio_to_channel(pin) == PWM_CHAN_B);
-    next_ = time_us_64();
     auto cfg = pwm_get_default_config();
     pwm_config_set_clkdiv_mode(&cfg, PWM_DIV_B_RISING);
-    auto slice_num = pwm_gpio_to_slice_num(pin);
-    pwm_init(slice_num, &cfg, false);
+    pwm_init(SLICE, &cfg, false);
     gpio_set_function(pin, GPIO_FUNC_PWM);
+    gpio_add_raw_irq_handler(pin, edge_handler);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+    FreqWraps::enable(SLICE);
+    pwm_set_enabled(SLICE, true);
+    auto irq = save_and_disable_interrupts();
+    window_count_ = FreqWraps::count(SLICE);
+    window_time_ = time_us_64();
+    restore_interrupts(irq);
+    next_ = window_time_ + window_us_;
   }
 
-  auto periodic() {
-    auto now = time_us_64();
-    if (next_ < now) {
-      static constexpr uint64_t NEXT_INCREMENT =
-          sample_seconds * 1000UL * 1000UL;
-      uint slice_num = pwm_gpio_to_slice_num(pin);
-      pwm_set_enabled(slice_num, false);
-      value_ = pwm_get_counter(slice_num);
-      updated_ = true;
-      pwm_set_counter(slice_num, 0);
-      pwm_set_enabled(slice_num, true);
-      next_ = NEXT_INCREMENT + now;
+  // Takes effect from the window in progress.
+  auto set_window(uint32_t ms) -> void {
+    if (ms == 0) return;
+    next_ = next_ - window_us_ + (ms * 1000ULL);
+    window_us_ = ms * 1000ULL;
+  }
+  auto window() const -> uint32_t {
+    return static_cast<uint32_t>(window_us_ / 1000);
+  }
+
+  auto periodic(uint64_t now) {
+    if (next_ > now) return;
+    // Keep the windows on their own cadence unless we have fallen behind.
+    next_ += window_us_;
+    if (next_ <= now) next_ = now + window_us_;
+
+    auto irq = save_and_disable_interrupts();
+    auto count = FreqWraps::count(SLICE);
+    auto time = time_us_64();
+    auto edge_time = edge_time_;
+    auto edge_count = edge_count_;
+    restore_interrupts(irq);
+
+    if (!reciprocal_ || !edge_valid_) {
+      value_ = per_second(count - window_count_, time - window_time_);
+    } else if (edge_time != last_edge_time_) {
+      value_ = per_second(edge_count - last_edge_count_,
+                          edge_time - last_edge_time_);
+    } else {
+      // No edges this window, it is at most one edge since the last.
+      auto bound = per_second(1, time - last_edge_time_);
+      if (bound < value_) value_ = bound;
+    }
+    if (reciprocal_ && edge_time != 0) {
+      last_edge_time_ = edge_time;
+      last_edge_count_ = edge_count;
+      edge_valid_ = true;
+    }
+    window_count_ = count;
+    window_time_ = time;
+    ++sequence_;
+
+    if (!reciprocal_ && value_ < RECIPROCAL_ENTER_MHZ) {
+      set_reciprocal(true);
+    } else if (reciprocal_ && value_ > RECIPROCAL_LEAVE_MHZ) {
+      set_reciprocal(false);
     }
   }
 
-  auto value() {
-    updated_ = false;
-    return value_;
+  auto deadline() { return next_; }
+
+  // Last frequency in millihertz, measured over the window ending at time().
+  auto value() const { return value_; }
+  auto time() const { return window_time_; }
+  auto sequence() const { return sequence_; }
+
+  // Total edges counted.
+  auto count() {
+    auto irq = save_and_disable_interrupts();
+    auto count = FreqWraps::count(SLICE);
+    restore_interrupts(irq);
+    return count;
   }
-  auto updated() { return updated_; }
 
  private:
+  // As pwm_gpio_to_slice_num(), usable at compile time.
+  static constexpr uint SLICE = (pin >> 1) & 7u;
+
+  // Count at and time of the latest edge, updated by edge_handler().
+  static inline volatile uint64_t edge_time_ = 0;
+  static inline volatile uint32_t edge_count_ = 0;
+
+  static auto edge_handler() -> void {
+    if (gpio_get_irq_event_mask(pin) & GPIO_IRQ_EDGE_RISE) {
+      gpio_acknowledge_irq(pin, GPIO_IRQ_EDGE_RISE);
+      edge_count_ = FreqWraps::count(SLICE);
+      edge_time_ = time_us_64();
+    }
+  }
+
+  static auto per_second(uint32_t edges, uint64_t elapsed_us) -> uint32_t {
+    if (elapsed_us == 0) return 0;
+    return static_cast<uint32_t>((edges * 1000ULL * 1000ULL * 1000ULL) /
+                                 elapsed_us);
+  }
+
+  auto set_reciprocal(bool enable) -> void {
+    auto irq = save_and_disable_interrupts();
+    edge_time_ = 0;
+    restore_interrupts(irq);
+    edge_valid_ = false;
+    reciprocal_ = enable;
+    gpio_set_irq_enabled(pin, GPIO_IRQ_EDGE_RISE, enable);
+  }
+
+  uint64_t window_us_;
   uint64_t next_;
-  uint16_t value_;
-  bool updated_;
+  uint64_t window_time_;
+  uint32_t window_count_;
+  uint64_t last_edge_time_;
+  uint32_t last_edge_count_;
+  uint32_t value_;
+  uint32_t sequence_;
+  bool reciprocal_;
+  bool edge_valid_;
 };
 
-#endif  // IO_LED_H
+#endif  // IO_FREQ_H
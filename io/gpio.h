@@ -1,6 +1,10 @@
 #ifndef IO_GPIO_H
 #define IO_GPIO_H
 
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
 #include "hardware/gpio.h"
 
 template <uint pin, bool out>
@@ -14,4 +18,66 @@ struct Gpio {
   constexpr auto get_pin() { return pin; }
 };
 
+struct GpioOutput {
+  uint pin;
+  bool active_high;
+};
+
+// Outputs in one bank written together. Values are a bit per output in
+// template order, true for active, and are spread onto the pins with the
+// polarity applied so a write is a single gpio_put_masked(), which changes
+// every pin in the mask on the same clock. With constant arguments the
+// masks fold to constants.
+template <GpioOutput... outputs>
+class GpioGroup {
+ public:
+  static constexpr size_t size = sizeof...(outputs);
+  static constexpr uint32_t ALL = (size < 32) ? (1u << size) - 1 : ~0u;
+  static constexpr uint32_t MASK = ((1u << outputs.pin) | ... | 0u);
+
+  static_assert(((outputs.pin < 32) && ...), "Bank 0 pins only");
+  static_assert(std::popcount(MASK) == size, "Duplicate pin");
+
+  // Pins of the outputs in bits, and the pin levels for them.
+  static constexpr auto pins(uint32_t bits) -> uint32_t {
+    uint32_t mask = 0;
+    size_t index = 0;
+    ((mask |= ((bits >> index++) & 1u) << outputs.pin), ...);
+    return mask;
+  }
+  static constexpr auto levels(uint32_t bits) -> uint32_t {
+    return pins(bits ^ inactive());
+  }
+
+  // All inactive, set before the pins become outputs.
+  auto init() {
+    gpio_init_mask(MASK);
+    gpio_put_masked(MASK, levels(0));
+    gpio_set_dir_out_masked(MASK);
+  }
+
+  // Outputs in mask to their bit in values, the rest are left.
+  auto put(uint32_t mask, uint32_t values) {
+    gpio_put_masked(pins(mask), levels(values));
+  }
+  auto put(uint32_t values) { put(ALL, values); }
+
+  auto get() -> uint32_t {
+    auto all = gpio_get_all();
+    uint32_t bits = 0;
+    size_t index = 0;
+    ((bits |= ((all >> outputs.pin) & 1u) << index++), ...);
+    return bits ^ inactive();
+  }
+
+ private:
+  // Bit per output, set for the active low ones.
+  static constexpr auto inactive() -> uint32_t {
+    uint32_t bits = 0;
+    size_t index = 0;
+    ((bits |= (outputs.active_high ? 0u : 1u) << index++), ...);
+    return bits;
+  }
+};
+
 #endif  // IO_GPIO_H
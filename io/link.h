@@ -0,0 +1,55 @@
+#ifndef IO_LINK_H
+#define IO_LINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include "hardware/uart.h"
+
+// Byte stream over a uart with both directions moved by DMA.
+// Receive runs continuously into a ring buffer and the DMA transfer count
+// says how much has arrived, so nothing is lost as long as poll() and
+// read_buffer() keep within RX_SIZE bytes of it. Writes are queued whole or
+// not at all into a second ring and given to the DMA a contiguous run at a
+// time. There are no interrupts, poll() does all the work.
+class Link {
+ public:
+  static constexpr size_t RX_SIZE = 256;
+  static constexpr size_t TX_SIZE = 512;
+
+  Link();
+
+  auto init(uart_inst_t *uart, uint tx_pin, uint rx_pin, uint baud) -> void;
+  auto ready() const -> bool { return uart_ != nullptr; }
+
+  // Restart finished transfers, the sooner the less latency.
+  auto poll() -> void;
+
+  // Received bytes, a contiguous run so maybe not all of them.
+  auto read_buffer() -> std::pair<const uint8_t *, size_t>;
+  auto read_done(size_t length) -> void;
+
+  auto write(const uint8_t *data, size_t length) -> bool;
+  auto room() const -> size_t { return TX_SIZE - (tx_head_ - tx_tail_); }
+
+  // Times received bytes were overwritten before being read.
+  auto overruns() const -> uint32_t { return overruns_; }
+
+ private:
+  auto received() const -> uint32_t;
+
+  uart_inst_t *uart_;
+  uint rx_channel_;
+  uint tx_channel_;
+  // Bytes in finished receive transfers and bytes read, since init().
+  uint32_t rx_done_;
+  uint32_t rx_read_;
+  // Queued bytes as free running indices, sending is the run the DMA has.
+  uint32_t tx_head_;
+  uint32_t tx_tail_;
+  uint32_t tx_sending_;
+  uint32_t overruns_;
+};
+
+#endif  // IO_LINK_H
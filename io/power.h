@@ -0,0 +1,43 @@
+#ifndef IO_POWER_H
+#define IO_POWER_H
+
+#include <cstdint>
+
+// Clock scaling for when the host has gone quiet.
+// clk_peri is moved to the 48 MHz usb pll at init() so uart baud rates don't
+// depend on clk_sys. After IDLE_US without usb traffic clk_sys is switched
+// to the usb pll as well and the system pll stopped; the next traffic
+// starts it again and switches back. The timer runs from clk_ref and pwm
+// only counts edges, so sensor windows and alarms are unaffected and the
+// core still sleeps in __wfe() between deadlines either way. Dormant mode
+// isn't used as it stops the timer and usb.
+class Power {
+ public:
+  static constexpr uint64_t IDLE_US = 2 * 1000 * 1000;
+
+  Power();
+
+  auto init(uint64_t now) -> void;
+
+  // Usb traffic, back to full speed if slowed.
+  auto active(uint64_t now) -> void;
+  // About to sleep, slows down once idle long enough.
+  auto idle(uint64_t now) -> void;
+
+  auto slow() const -> bool { return slow_; }
+  // Time spent slowed and times woken back to full speed, since boot.
+  auto slow_us(uint64_t now) const -> uint64_t {
+    return slow_us_ + (slow_ ? now - since_ : 0);
+  }
+  auto wakes() const -> uint32_t { return wakes_; }
+
+ private:
+  bool slow_;
+  uint64_t last_active_;
+  // When slowed last.
+  uint64_t since_;
+  uint64_t slow_us_;
+  uint32_t wakes_;
+};
+
+#endif  // IO_POWER_H
@@ -0,0 +1,85 @@
+#ifndef IO_RING_SINK_H
+#define IO_RING_SINK_H
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "io/format.h"
+
+// Output ring buffer with printf style formatting.
+// Filled by the formatters and drained in contiguous spans through
+// write_buffer()/write_done(). One slot is kept empty to tell a full buffer
+// from an empty one, output that does not fit is dropped and counted.
+template <size_t size>
+class RingSink {
+  using FORMAT = const char *;
+
+ public:
+  RingSink() : index_{0}, sent_{0}, high_water_{0}, dropped_{0} {}
+
+  auto room() const -> size_t { return (sent_ + size - index_ - 1) % size; }
+  auto empty() const -> bool { return index_ == sent_; }
+
+  auto putc(char c) -> bool { return write(&c, 1) == 1; }
+
+  auto write(const char *data, size_t length) -> size_t {
+    auto free = room();
+    if (length > free) {
+      dropped_ += length - free;
+      length = free;
+    }
+    auto used = size - 1 - free + length;
+    if (used > high_water_) high_water_ = used;
+    // Copy in up to two segments if the free space wraps.
+    auto first = size - index_;
+    if (first > length) first = length;
+    memcpy(&buffer_[index_], data, first);
+    memcpy(buffer_, data + first, length - first);
+    index_ = (index_ + length) % size;
+    return length;
+  }
+
+  auto printf(FORMAT format...) -> int {
+    va_list args;
+    va_start(args, format);
+    int result = vprintf(format, args);
+    va_end(args);
+    return result;
+  }
+
+  auto vprintf(FORMAT format, va_list args) -> int {
+    auto writer = Format::Writer{
+        this, [](void *context, const char *data, size_t length) {
+          return static_cast<RingSink *>(context)->write(data, length);
+        }};
+    return Format::vwrite(writer, format, args);
+  }
+
+  template <FormatString format, typename... Args>
+  auto print(Args... args) -> bool {
+    return Format::write<format>(*this, args...);
+  }
+
+  auto write_buffer() -> std::pair<const char *, size_t> {
+    // If buffer has been wrapped send up to the end first.
+    auto length = (index_ < sent_) ? size - sent_ : index_ - sent_;
+    return std::pair<const char *, size_t>{&buffer_[sent_], length};
+  }
+
+  auto write_done(size_t length) -> void { sent_ = (sent_ + length) % size; }
+
+  // Most ever queued and bytes dropped for want of room.
+  auto high_water() const -> size_t { return high_water_; }
+  auto dropped() const -> size_t { return dropped_; }
+
+ private:
+  char buffer_[size];
+  size_t index_;
+  size_t sent_;
+  size_t high_water_;
+  size_t dropped_;
+};
+
+#endif  // IO_RING_SINK_H
@@ -0,0 +1,55 @@
+#ifndef IO_SCHEDULER_H
+#define IO_SCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Deadline scheduler.
+// Tasks are small integer ids kept in an indexed min-heap ordered by their
+// next deadline, so the earliest deadline is always at the top and a task can
+// be moved or cancelled in O(log n). Sleeping is done with __wfe() with a
+// hardware alarm armed for the earliest deadline.
+class Scheduler {
+ public:
+  using Id = uint8_t;
+  static constexpr Id MAX_TASKS = 48;
+  static constexpr Id NONE = 0xff;
+  static constexpr uint64_t NEVER = UINT64_MAX;
+
+  Scheduler();
+
+  auto init() -> void;
+
+  // Set (or move) the deadline of a task, a deadline of zero cancels it.
+  auto schedule(Id id, uint64_t deadline) -> void;
+  auto cancel(Id id) -> void;
+  auto scheduled(Id id) const -> bool { return position_[id] != NONE; }
+  auto next_deadline() const -> uint64_t {
+    return (size_ == 0) ? NEVER : heap_[0].deadline;
+  }
+
+  // Remove and return the earliest task due at or before now, or NONE.
+  auto pop(uint64_t now) -> Id;
+
+  // Sleep until the next deadline, or until if that's sooner, or any other
+  // interrupt.
+  auto sleep(uint64_t until = NEVER) -> void;
+
+ private:
+  struct Entry {
+    uint64_t deadline;
+    Id id;
+  };
+
+  auto remove(size_t index) -> void;
+  auto sift_up(size_t index) -> void;
+  auto sift_down(size_t index) -> void;
+  auto place(size_t index, const Entry& entry) -> void;
+
+  Entry heap_[MAX_TASKS];
+  Id position_[MAX_TASKS];
+  size_t size_;
+  int alarm_;
+};
+
+#endif  // IO_SCHEDULER_H
@@ -0,0 +1,59 @@
+#ifndef IO_SPSC_H
+#define IO_SPSC_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Lock free single producer, single consumer byte ring.
+// Safe to share between the two cores as long as only one of them produces
+// and only the other consumes. The indices run freely and are masked on use,
+// so size must be a power of two.
+template <size_t size>
+class Spsc {
+  static_assert((size & (size - 1)) == 0, "Spsc size must be a power of 2");
+
+ public:
+  Spsc() : head_{0}, tail_{0} {}
+
+  // Producer side, contiguous free space then commit what was written.
+  auto claim() -> std::pair<uint8_t*, size_t> {
+    auto head = head_.load(std::memory_order_relaxed);
+    auto tail = tail_.load(std::memory_order_acquire);
+    auto index = head & (size - 1);
+    auto free = size - (head - tail);
+    auto contiguous = size - index;
+    return {&buffer_[index], (free < contiguous) ? free : contiguous};
+  }
+  auto commit(size_t length) -> void {
+    head_.store(head_.load(std::memory_order_relaxed) + length,
+                std::memory_order_release);
+  }
+
+  // Consumer side, contiguous pending data then consume what was used.
+  auto peek() -> std::pair<const uint8_t*, size_t> {
+    auto tail = tail_.load(std::memory_order_relaxed);
+    auto head = head_.load(std::memory_order_acquire);
+    auto index = tail & (size - 1);
+    auto pending = head - tail;
+    auto contiguous = size - index;
+    return {&buffer_[index], (pending < contiguous) ? pending : contiguous};
+  }
+  auto consume(size_t length) -> void {
+    tail_.store(tail_.load(std::memory_order_relaxed) + length,
+                std::memory_order_release);
+  }
+
+  auto empty() const -> bool {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  std::atomic<size_t> head_;
+  std::atomic<size_t> tail_;
+  uint8_t buffer_[size];
+};
+
+#endif  // IO_SPSC_H
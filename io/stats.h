@@ -0,0 +1,79 @@
+#ifndef IO_STATS_H
+#define IO_STATS_H
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+
+// Main loop instrumentation, cheap enough to leave on: a timer read and a few
+// adds per component each pass. Pass times are the busy part of one
+// Framework::periodic(), sleeping isn't counted, and go into a histogram of
+// powers of two microseconds. Channels are counted by usb cdc channel.
+class Stats {
+ public:
+  enum Component : uint8_t { USB = 0, CONSOLE, API, APP, NUM_COMPONENTS };
+  static constexpr size_t NUM_BUCKETS = 16;
+  static constexpr size_t NUM_CHANNELS = 2;
+
+  struct Channel {
+    uint32_t in;
+    uint32_t out;
+    // Of the output ring since boot, reset() leaves these.
+    uint32_t high_water;
+    uint32_t dropped;
+  };
+
+  Stats() : channels_{} { reset(); }
+
+  auto reset() -> void {
+    passes_ = 0;
+    min_us_ = UINT32_MAX;
+    max_us_ = 0;
+    for (auto &bucket : histogram_) bucket = 0;
+    for (auto &time : time_us_) time = 0;
+    for (auto &channel : channels_) channel.in = channel.out = 0;
+  }
+
+  auto pass(uint32_t us) -> void {
+    ++passes_;
+    if (us < min_us_) min_us_ = us;
+    if (us > max_us_) max_us_ = us;
+    auto bucket = static_cast<size_t>(std::bit_width(us));
+    ++histogram_[(bucket < NUM_BUCKETS) ? bucket : NUM_BUCKETS - 1];
+  }
+  auto add(Component component, uint32_t us) -> void {
+    time_us_[component] += us;
+  }
+  auto transfer(uint8_t channel, size_t in, size_t out) -> void {
+    channels_[channel].in += in;
+    channels_[channel].out += out;
+  }
+  auto ring(uint8_t channel, size_t high_water, size_t dropped) -> void {
+    channels_[channel].high_water = high_water;
+    channels_[channel].dropped = dropped;
+  }
+
+  auto passes() const -> uint32_t { return passes_; }
+  auto min_us() const -> uint32_t { return passes_ ? min_us_ : 0; }
+  auto max_us() const -> uint32_t { return max_us_; }
+  // Bucket n counts passes of [2^(n-1), 2^n) us, the last anything longer.
+  auto histogram(size_t bucket) const -> uint32_t {
+    return histogram_[bucket];
+  }
+  auto time_us(Component component) const -> uint64_t {
+    return time_us_[component];
+  }
+  auto channel(uint8_t channel) const -> const Channel & {
+    return channels_[channel];
+  }
+
+ private:
+  uint32_t passes_;
+  uint32_t min_us_;
+  uint32_t max_us_;
+  uint32_t histogram_[NUM_BUCKETS];
+  uint64_t time_us_[NUM_COMPONENTS];
+  Channel channels_[NUM_CHANNELS];
+};
+
+#endif  // IO_STATS_H
@@ -0,0 +1,77 @@
+#ifndef IO_STORE_H
+#define IO_STORE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Key/value store kept in the last two sectors of flash.
+// Values are appended to a log in the active sector, a later record for a
+// key replaces the earlier one and a zero length record deletes it. Nothing
+// is erased until the sector is full, then the live values are copied to the
+// other sector under a higher generation, so the two sectors take turns and
+// wear evenly. An index of each key's latest record is built by one scan at
+// init() and kept in RAM, so reads are straight from the XIP window.
+// A record torn by a reset is ignored and the sector compacted on the next
+// write. Writes stall both cores for a flash page program, or an erase when
+// compacting.
+class Store {
+ public:
+  using Key = uint8_t;
+  static constexpr Key MAX_KEYS = 64;
+  static constexpr size_t MAX_VALUE = 32;
+
+  Store();
+
+  auto init() -> void;
+
+  // False unless the key has a value of exactly length bytes.
+  auto get(Key key, void *value, size_t length) const -> bool;
+  auto put(Key key, const void *value, size_t length) -> bool;
+  auto erase(Key key) -> bool;
+  auto contains(Key key) const -> bool {
+    return key < MAX_KEYS && index_[key] != 0;
+  }
+
+  template <typename T>
+  auto get(Key key, T &value) const -> bool {
+    return get(key, &value, sizeof(T));
+  }
+  template <typename T>
+  auto put(Key key, const T &value) -> bool {
+    return put(key, &value, sizeof(T));
+  }
+
+  // Bytes of the active sector used, and its generation.
+  auto used() const -> size_t { return end_; }
+  auto generation() const -> uint32_t { return generation_; }
+
+ private:
+  struct Header {
+    uint32_t magic;
+    uint32_t generation;
+  };
+
+  struct Record {
+    Key key;
+    uint8_t length;
+    uint16_t check;
+  };
+
+  static auto sector_address(uint8_t sector) -> uint32_t;
+  static auto check(const Record &record, const uint8_t *value) -> uint16_t;
+  static auto record_size(size_t length) -> size_t {
+    return sizeof(Record) + ((length + 3) & ~size_t{3});
+  }
+
+  auto scan(uint8_t sector) -> void;
+  auto append(Key key, const void *value, size_t length) -> bool;
+  auto compact(Key key, const void *value, size_t length) -> bool;
+
+  // Offset of each key's latest record in the active sector, 0 for none.
+  uint16_t index_[MAX_KEYS];
+  uint8_t active_;
+  uint32_t generation_;
+  size_t end_;
+};
+
+#endif  // IO_STORE_H
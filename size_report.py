@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Flash and RAM used by each module, from a GNU ld map file.
+
+    size_report.py <elf.map> [budget]
+
+The firmware's own sources are reported one by one, everything else grouped
+as pico-sdk, tinyusb or the library it came from. Flash is code, read only
+data and the initial values of RAM data, RAM is everything at run time,
+including the stacks and heap. With a budget file, lines of
+
+    <module> <flash bytes> <ram bytes>
+
+with total for the whole image, exits 1 when anything is over its budget.
+"""
+
+import re
+import sys
+
+# Input sections taking RAM that have no initial values in flash.
+NO_LOAD = re.compile(r"\.(bss|uninitialized_data|heap|stack|scratch_[xy]_bss)"
+                     r"|COMMON")
+# Input sections in RAM, anything else is flash only.
+IN_RAM = re.compile(r"\.(data|bss|uninitialized_data|heap|stack|scratch_|"
+                    r"time_critical|ram_vector_table)|COMMON")
+# An input section, maybe with its name on the line before.
+SECTION = re.compile(r"^ (\S+)?\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$")
+NAME = re.compile(r"^ (\S+)$")
+
+
+def module(path):
+    """Short name of where an input section came from."""
+    if "tinyusb" in path:
+        return "tinyusb"
+    archive = re.match(r"(?:.*/)?([^/(]+)\.a\(", path)
+    if archive:
+        return archive.group(1)
+    # Sources in the project are built to paths relative to it.
+    own = re.search(r"\.dir/((?:src|io|app)/.*\.(?:c|cpp|S))\.obj?$", path)
+    if own:
+        return own.group(1)
+    if re.search(r"/crt[^/]*\.o$", path):
+        return "libgcc"
+    return "pico-sdk"
+
+
+def read(path):
+    sizes = {}
+    in_map = False
+    name = None
+    with open(path) as lines:
+        for line in lines:
+            line = line.rstrip("\n")
+            if line.startswith("Linker script and memory map"):
+                in_map = True
+                continue
+            if not in_map:
+                continue
+            match = NAME.match(line)
+            if match:
+                name = match.group(1)
+                continue
+            match = SECTION.match(line)
+            if not match:
+                name = None
+                continue
+            section = match.group(1) or name
+            name = None
+            size = int(match.group(3), 16)
+            if section is None or size == 0 or section.startswith("*"):
+                continue
+            used = sizes.setdefault(module(match.group(4)), [0, 0])
+            if IN_RAM.match(section):
+                used[1] += size
+                if not NO_LOAD.match(section):
+                    used[0] += size
+            elif not section.startswith((".ARM.attributes", ".comment",
+                                         ".debug")):
+                used[0] += size
+    return sizes
+
+
+def budgets(path):
+    result = {}
+    with open(path) as lines:
+        for number, line in enumerate(lines, 1):
+            line = line.split("#")[0].strip()
+            if not line:
+                continue
+            fields = line.split()
+            if len(fields) != 3:
+                sys.exit(f"{path}:{number}: expected <module> <flash> <ram>")
+            result[fields[0]] = (int(fields[1], 0), int(fields[2], 0))
+    return result
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit(__doc__.strip().splitlines()[2].strip())
+    sizes = read(sys.argv[1])
+    limits = budgets(sys.argv[2]) if len(sys.argv) == 3 else {}
+    total = [sum(size[0] for size in sizes.values()),
+             sum(size[1] for size in sizes.values())]
+    over = []
+    print(f"{'module':<32} {'flash':>8} {'ram':>8}")
+    rows = sorted(sizes.items(), key=lambda item: -sum(item[1]))
+    for name, size in rows + [("total", total)]:
+        limit = limits.get(name)
+        mark = ""
+        if limit:
+            mark = f"   of {limit[0]:>8} {limit[1]:>8}"
+            for kind, used, allowed in zip(("flash", "ram"), size, limit):
+                if used > allowed:
+                    over.append(f"{name} {kind} {used} > {allowed}")
+        print(f"{name:<32} {size[0]:>8} {size[1]:>8}{mark}")
+    for name in limits.keys() - sizes.keys() - {"total"}:
+        print(f"{name:<32} {'not linked':>17}")
+    for line in over:
+        print(f"over budget: {line}", file=sys.stderr)
+    return 1 if over else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,9 +1,14 @@
 #include "app/app.h"
 
 #include <array>
+#include <cstring>
+#include <string_view>
 
+#include "hardware/uart.h"
 #include "hardware/watchdog.h"
+#include "io/buffer_sink.h"
 #include "io/framework.h"
+#include "io/ring_sink.h"
 #include "pico/binary_info.h"
 #include "pico/bootrom.h"
 
@@ -13,126 +18,206 @@ using FORMAT = const char *;
 
 constexpr uint64_t TIMEOUT_DELAY = 10 * 1000UL * 1000UL;
 constexpr unsigned RESET_DELAY_MS = 100;
+constexpr uint64_t TELEMETRY_RETRY_DELAY = 10 * 1000UL;
+// Longest a metered valve stays open when no limit is given.
+constexpr unsigned VOLUME_TIMEOUT_SEC = 60 * 60;
+constexpr uint32_t MAX_WINDOW_MS = 60 * 1000;
+// A link poll every RX_SIZE byte times would do, this is well inside it.
+constexpr uint64_t LINK_POLL_US = 1000;
+static_assert(LINK_POLL_US * UART_BAUD / 10 / 1000 / 1000 < Link::RX_SIZE / 4);
+static_assert(protocol::KEY_STEP + Sequencer::MAX_STEPS <= Store::MAX_KEYS);
+static_assert(protocol::KEY_FAILSAFE < Store::MAX_KEYS);
+// A main loop stalled this long is reset by the hardware watchdog, which
+// leaves the valve pins undriven. Longer than a worst case flash sector
+// erase, about 400 ms, the store feeds it either side of each flash
+// operation as a compaction's erase and programs together can take longer.
+constexpr uint32_t WATCHDOG_MS = 500;
+constexpr uint64_t WATCHDOG_FEED_US = WATCHDOG_MS * 1000 / 4;
+constexpr uint32_t MAX_HEARTBEAT_MS = 24 * 60 * 60 * 1000;
 
-constexpr size_t output_bufferSIZE = 2048;
-static char output_buffer[output_bufferSIZE];
+constexpr size_t OUTPUT_BUFFER_SIZE = API_OUTPUT_BUFFER_SIZE;
+// Longest telemetry reading as text, ",[255,4294967295,65535,4294967295]".
+constexpr size_t MAX_READING_TEXT = 34;
+// ",[4294967295,4294967295,255,4294967295]".
+constexpr size_t MAX_RECORD_TEXT = 40;
+static RingSink<OUTPUT_BUFFER_SIZE> output;
+// Output room kept while a text batch runs for the replies still to come,
+// history replies, which fill what room there is, leave it be.
+static size_t reserved = 0;
 
-constexpr size_t RX_BUFFER_SIZE = 64 + 1;
-static uint8_t rx_buffer[RX_BUFFER_SIZE];
+auto unreserved() -> size_t {
+  auto room = output.room();
+  return (room > reserved) ? room - reserved : 0;
+}
+
+// Longest status text, R{"q":4294967295,"l":255,"a":65535 then
+// ,"v15":1 per valve, ,"<key>":-4294967.295 per sensor and }\r\n.
+constexpr auto max_status_text() -> size_t {
+  size_t size = 34 + 3;
+  size += NUM_VALVES * 8;
+  for (const auto &sensor : SENSORS) {
+    size += 16;
+    for (auto key = sensor.key; *key != '\0'; ++key) ++size;
+  }
+  return size;
+}
 
-static Conversion conversion;
-static size_t tx_index;
-static size_t tx_sent;
+// Keys of the s reply in its original order. "m2" has never had a sensor and
+// is always -0, sensors without a key here go on the end.
+constexpr const char *STATUS_KEYS[] = {"m0", "m1", "m2", "f0", "f1"};
 
-auto respond_putc(char c) -> bool {
-  auto new_index = tx_index + 1;
-  // wrap the buffer.
-  if (new_index >= sizeof(output_buffer)) {
-    new_index = 0;
+constexpr auto keyed(const char *key) -> uint8_t {
+  for (uint8_t sensor = 0; sensor < NUM_SENSORS; ++sensor) {
+    if (std::string_view{SENSORS[sensor].key} == key) return sensor;
   }
-  // Check for buffer full.
-  if (new_index == tx_sent) {
-    return false;
+  return NO_SENSOR;
+}
+
+constexpr auto unkeyed() -> uint16_t {
+  uint16_t sensors = (1u << NUM_SENSORS) - 1;
+  for (auto key : STATUS_KEYS) {
+    if (keyed(key) != NO_SENSOR) sensors &= ~(1u << keyed(key));
   }
-  output_buffer[tx_index] = c;
-  tx_index = new_index;
-  return true;
+  return sensors;
 }
 
-auto vrespond(FORMAT format, va_list args) -> int {
-  int result;
-  bool room = true;
-  while (room && *format != '\0') {
-    if (*format == '%') {
-      ++format;
-      auto type = conversion.parse(format);
-      if (type == Conversion::Type::UNKNOWN) {
-        break;
-      }
-      const char *buffer = nullptr;
-      switch (type) {
-        case Conversion::Type::PERCENT: {
-          buffer = conversion.from_character('%');
-        } break;
-        case Conversion::Type::CHARACTER: {
-          auto value = va_arg(args, int);
-          buffer = conversion.from_character(value);
-        } break;
-        case Conversion::Type::SIGNED_INT: {
-          auto value = va_arg(args, int);
-          buffer = conversion.from_signed_int(value);
-        } break;
-        case Conversion::Type::UNSIGNED_INT: {
-          auto value = va_arg(args, unsigned);
-          buffer = conversion.from_unsigned_int(value);
-        } break;
-        case Conversion::Type::LONG_SIGNED_INT: {
-          auto value = va_arg(args, long);
-          buffer = conversion.from_signed_int(value);
-        } break;
-        case Conversion::Type::LONG_UNSIGNED_INT: {
-          auto value = va_arg(args, unsigned long);
-          buffer = conversion.from_unsigned_int(value);
-        } break;
-        case Conversion::Type::LONG_LONG_SIGNED_INT: {
-          auto value = va_arg(args, long long);
-          buffer = conversion.from_signed_int(value);
-        } break;
-        case Conversion::Type::LONG_LONG_UNSIGNED_INT: {
-          auto value = va_arg(args, unsigned long long);
-          buffer = conversion.from_unsigned_int(value);
-        } break;
-        case Conversion::Type::POINTER: {
-          auto value = (uint32_t)va_arg(args, void *);
-          buffer = conversion.from_unsigned_int(value);
-        } break;
-        case Conversion::Type::DOUBLE: {
-          auto value = va_arg(args, double);
-          buffer = conversion.from_double(value);
-        } break;
-        case Conversion::Type::STRING: {
-          auto value = va_arg(args, char *);
-          buffer = conversion.from_string(value);
-        } break;
-        default:
-          break;
-      }
-      if (buffer) {
-        while (room && *buffer != '\0') {
-          room = respond_putc(*buffer++);
-        }
-      }
-    } else {
-      room = respond_putc(*format++);
-      ++result;
-    }
+// Longest s text, R{"l":255 then ,"v15":1 per valve, ,"<key>":-4294967295
+// per key and sensor without one and }\r\n.
+constexpr auto max_poll_text() -> size_t {
+  size_t size = 9 + 3 + (NUM_VALVES * 8);
+  auto add = [&size](const char *key) {
+    size += 15;
+    for (; *key != '\0'; ++key) ++size;
+  };
+  for (auto key : STATUS_KEYS) add(key);
+  for (uint8_t sensor = 0; sensor < NUM_SENSORS; ++sensor) {
+    if (unkeyed() & (1u << sensor)) add(SENSORS[sensor].key);
   }
-  return result;
+  return size;
 }
 
+// Status as last shown, rendered as the snapshot and the q text once per
+// generation and as the s text when that or its marks change. Anything in it
+// changing makes it stale and the next status request rebuilds it, so polls
+// in between are copies.
+struct StatusCache {
+  bool stale = true;
+  protocol::Snapshot snapshot = {};
+  BufferSink<max_status_text()> text;
+  // The s reply as at poll_generation, with the bit per sensor in poll_marks
+  // shown as updated.
+  uint32_t poll_generation = 0;
+  uint16_t poll_marks = 0;
+  BufferSink<max_poll_text()> poll;
+};
+static StatusCache status_cache;
+
+constexpr size_t RX_BUFFER_SIZE = 64 + 1;
+static uint8_t rx_buffer[RX_BUFFER_SIZE];
+
 auto respond(FORMAT format...) -> int {
   va_list args;
   va_start(args, format);
-  int result = vrespond(format, args);
+  int result = output.vprintf(format, args);
   va_end(args);
   return result;
 }
 
+// Compile time specialised respond for the hot replies.
+template <FormatString format, typename... Args>
+auto respond(Args... args) -> bool {
+  return output.print<format>(args...);
+}
+
+// Replies to the requests in a BATCH frame, collected into one BATCH_REPLY.
+struct Capture {
+  bool active = false;
+  size_t length = 0;
+  uint8_t data[Frame::MAX_PAYLOAD];
+};
+static Capture capture;
+
+// Frames are queued whole or not at all so the stream never loses sync.
+auto respond_frame(protocol::Type type, const void *payload,
+                   size_t length) -> bool {
+  if (capture.active) {
+    if (capture.length + sizeof(protocol::Entry) + length >
+        sizeof(capture.data))
+      return false;
+    auto entry = protocol::Entry{type, static_cast<uint8_t>(length)};
+    memcpy(&capture.data[capture.length], &entry, sizeof(entry));
+    memcpy(&capture.data[capture.length + sizeof(entry)], payload, length);
+    capture.length += sizeof(entry) + length;
+    return true;
+  }
+  uint8_t frame[Frame::MAX_PAYLOAD + Frame::OVERHEAD];
+  auto size = Frame::encode(static_cast<uint8_t>(type), payload, length, frame);
+  if (size > output.room()) return false;
+  output.write(reinterpret_cast<const char *>(frame), size);
+  return true;
+}
+
+auto respond_ack(protocol::Type request, uint8_t target) -> bool {
+  auto ack = protocol::Ack{request, target};
+  return respond_frame(protocol::Type::ACK, &ack, sizeof(ack));
+}
+
+auto respond_nak(protocol::Type request, protocol::Error error) -> bool {
+  auto nak = protocol::Nak{request, error};
+  return respond_frame(protocol::Type::NAK, &nak, sizeof(nak));
+}
+
+template <typename T>
+auto decode(const uint8_t *payload, size_t length, T &request) -> bool {
+  if (length != sizeof(T)) return false;
+  memcpy(&request, payload, sizeof(T));
+  return true;
+}
+
 struct Parser {
-  enum class State { COMMAND, TARGET, NEXT_VALUE, VALUE };
-  enum class Command { NONE, STATUS, RESET, VALVE };
+  // DISCARD skips the rest of a number that overflowed.
+  enum class State { COMMAND, TARGET, NEXT_VALUE, VALUE, DISCARD };
+  enum class Command {
+    NONE,
+    STATUS,
+    STATUS_SINCE,
+    STATS,
+    HEARTBEAT,
+    RESET,
+    VALVE,
+    VOLUME,
+    MODE,
+    TELEMETRY,
+    HISTORY,
+    CONFIG,
+    PROGRAM,
+    RUN
+  };
 
   Parser()
-      : state{State::COMMAND}, command{Command::NONE}, target{0}, values{} {}
+      : state{State::COMMAND},
+        command{Command::NONE},
+        target{0},
+        index{0},
+        values{},
+        failed{false} {}
   auto reset() -> void;
+  auto fail() -> void;
   auto parse(char c) -> bool;
 
-  static constexpr uint8_t NUM_VALUES = 2;
+  // Values given, valid once parse() has returned true.
+  auto count() const -> uint8_t {
+    return (index < NUM_VALUES) ? index + 1 : NUM_VALUES;
+  }
+
+  static constexpr uint8_t NUM_VALUES = 4;
   State state;
   Command command;
   uint8_t target;
   uint8_t index;
-  std::array<uint16_t, NUM_VALUES> values;
+  std::array<uint32_t, NUM_VALUES> values;
+  // Set when a command was rejected, cleared by whoever checks it.
+  bool failed;
 };
 
 auto Parser::reset() -> void {
@@ -145,47 +230,87 @@ auto Parser::reset() -> void {
   }
 }
 
+auto Parser::fail() -> void {
+  reset();
+  failed = true;
+}
+
 auto Parser::parse(char c) -> bool {
   switch (state) {
     case State::COMMAND:
       if (c == 's' || c == 'S') {
         command = Command::STATUS;
         return true;
+      } else if (c == 'q' || c == 'Q') {
+        command = Command::STATUS_SINCE;
+        state = State::NEXT_VALUE;
+      } else if (c == 'k' || c == 'K') {
+        command = Command::HEARTBEAT;
+        state = State::NEXT_VALUE;
+      } else if (c == 'i' || c == 'I') {
+        command = Command::STATS;
+        return true;
       } else if (c == 'r' || c == 'R') {
         command = Command::RESET;
         state = State::NEXT_VALUE;
       } else if (c == 'v' || c == 'V') {
         command = Command::VALVE;
         state = State::TARGET;
+      } else if (c == 'w' || c == 'W') {
+        command = Command::VOLUME;
+        state = State::TARGET;
+      } else if (c == 'm' || c == 'M') {
+        command = Command::MODE;
+        state = State::NEXT_VALUE;
+      } else if (c == 't' || c == 'T') {
+        command = Command::TELEMETRY;
+        state = State::TARGET;
+      } else if (c == 'h' || c == 'H') {
+        command = Command::HISTORY;
+        state = State::NEXT_VALUE;
+      } else if (c == 'c' || c == 'C') {
+        command = Command::CONFIG;
+        state = State::NEXT_VALUE;
+      } else if (c == 'p' || c == 'P') {
+        command = Command::PROGRAM;
+        state = State::TARGET;
+      } else if (c == 'g' || c == 'G') {
+        command = Command::RUN;
+        state = State::NEXT_VALUE;
       } else if (c > ' ') {
         respond("Ec'%c'\r\n", c);
-        reset();
+        fail();
       }
       break;
     case State::TARGET:
       if (c == 27) {
         reset();
-      } else if (c >= '0' && c <= '9') {
-        target = static_cast<uint8_t>(c - '0');
+      } else if (auto digit = Conversion::digit(c); digit < 36) {
+        // One character, 0-9 then a-z for channels 10 and up.
+        target = static_cast<uint8_t>(digit);
         state = State::NEXT_VALUE;
       } else if (c > ' ') {
         respond("Et'%c'\r\n", c);
-        reset();
+        fail();
       }
       break;
     case State::NEXT_VALUE:
       if (c == 27) {
         reset();
-      } else if (c >= '0' && c <= '9') {
-        values[index] = static_cast<uint16_t>(c - '0');
+      } else if (auto digit = Conversion::digit(c); digit < 10) {
+        values[index] = digit;
         state = State::VALUE;
       }
       break;
     case State::VALUE:
       if (c == 27) {
         reset();
-      } else if (c >= '0' && c <= '9') {
-        values[index] = values[index] * 10 + static_cast<uint16_t>(c - '0');
+      } else if (auto digit = Conversion::digit(c); digit < 10) {
+        if (!Conversion::accumulate(values[index], digit, 10)) {
+          respond("En'%c'\r\n", c);
+          fail();
+          state = State::DISCARD;
+        }
       } else if (c == ',' || c == ':') {
         ++index;
         if (index < values.size()) {
@@ -197,113 +322,1359 @@ auto Parser::parse(char c) -> bool {
         return true;
       }
       break;
+    case State::DISCARD:
+      // Up to and including the separator after the number.
+      if (Conversion::digit(c) >= 10) state = State::COMMAND;
+      break;
   }
   return false;
 }
 
 static Parser parser{};
 
-}  // namespace
+// Text commands between '[' and ']', checked as a whole before any is run.
+struct Batch {
+  static constexpr size_t MAX_COMMANDS = 16;
+  bool open = false;
+  bool failed = false;
+  size_t count = 0;
+  std::array<Parser, MAX_COMMANDS> commands;
+};
+static Batch batch;
 
-App::App(Framework &framework) : framework_{framework}, timeout_{0} {
-  tx_index = 0;
-  tx_sent = 0;
+// Valve has a flow sensor.
+auto metered(uint8_t valve) -> bool {
+  return valve < protocol::NUM_VALVES && VALVES[valve].flow != NO_SENSOR;
+}
+
+// A value App::configure() can store for the key.
+auto valid_setting(uint8_t key, uint32_t value) -> bool {
+  if (key >= protocol::KEY_WINDOW &&
+      key < protocol::KEY_WINDOW + protocol::NUM_SENSORS)
+    return value != 0 && value <= MAX_WINDOW_MS;
+  if (key >= protocol::KEY_CALIBRATION &&
+      key < protocol::KEY_CALIBRATION + protocol::NUM_VALVES)
+    return true;
+  if (key == protocol::KEY_LINK) return value <= protocol::LINK_BROADCAST;
+  if (key == protocol::KEY_HEARTBEAT) return value <= MAX_HEARTBEAT_MS;
+  return false;
 }
 
+// p<step>:<valve>,<offset_sec>,<duration_sec>[,<after>]
+auto to_step(const Parser &command, Sequencer::Step &step) -> bool {
+  auto count = command.count();
+  auto &values = command.values;
+  if (count < 3 || values[0] >= protocol::NUM_VALVES || values[1] > 0xffff ||
+      values[2] > 0xffff)
+    return false;
+  if (count > 3 && values[3] >= Sequencer::MAX_STEPS) return false;
+  step = Sequencer::Step{static_cast<uint8_t>(values[0]),
+                         (count > 3) ? static_cast<uint8_t>(values[3])
+                                     : Sequencer::NONE,
+                         static_cast<uint16_t>(values[1]),
+                         static_cast<uint16_t>(values[2])};
+  return true;
+}
+
+auto to_step(const protocol::ProgramRequest &request,
+             Sequencer::Step &step) -> bool {
+  if (request.valve >= protocol::NUM_VALVES) return false;
+  if (request.after != Sequencer::NONE && request.after >= Sequencer::MAX_STEPS)
+    return false;
+  step = Sequencer::Step{request.valve, request.after, request.offset_sec,
+                         request.duration_sec};
+  return true;
+}
+
+// Whether a parsed command would succeed, so a batch is all or nothing, also
+// giving the most its reply can take. Commands that change the mode or reset
+// aren't allowed in a batch. Valves can only be closed while a failsafe is
+// latched.
+auto check(const Parser &command, const Sequencer &sequencer, bool latched,
+           size_t &reply) -> bool {
+  // As AV35\r\n.
+  reply = 6;
+  switch (command.command) {
+    case Parser::Command::STATUS:
+      reply = max_poll_text();
+      return true;
+    case Parser::Command::STATUS_SINCE:
+      reply = max_status_text();
+      return true;
+    case Parser::Command::HEARTBEAT:
+      return true;
+    case Parser::Command::HISTORY:
+      // H[]\r\n, records only go in what room is left.
+      reply = 5;
+      return true;
+    case Parser::Command::VALVE:
+      return command.target < protocol::NUM_VALVES &&
+             (!latched || command.values[0] == 0);
+    case Parser::Command::VOLUME:
+      return !latched && metered(command.target) && command.values[0] != 0 &&
+             command.values[1] <= 0xffff;
+    case Parser::Command::TELEMETRY:
+      return command.target < protocol::NUM_SENSORS &&
+             command.values[1] <= Telemetry::MAX_BATCH;
+    case Parser::Command::PROGRAM: {
+      Sequencer::Step step;
+      return !sequencer.running() && to_step(command, step) &&
+             command.target < Sequencer::MAX_STEPS &&
+             step.after != command.target;
+    }
+    default:
+      return false;
+  }
+}
+
+// As check() for one request in a BATCH frame, also giving the length of
+// its reply.
+auto check(protocol::Type type, const uint8_t *payload, size_t length,
+           const Sequencer &sequencer, bool latched, size_t &reply) -> bool {
+  switch (type) {
+    case protocol::Type::STATUS:
+      reply = sizeof(protocol::Status);
+      return length == 0;
+    case protocol::Type::HEARTBEAT: {
+      protocol::HeartbeatRequest request;
+      reply = sizeof(protocol::Ack);
+      return decode(payload, length, request);
+    }
+    case protocol::Type::SAMPLE: {
+      protocol::SampleRequest request;
+      reply = sizeof(protocol::Sample);
+      return decode(payload, length, request) &&
+             request.sensor < protocol::NUM_SENSORS;
+    }
+    case protocol::Type::VALVE: {
+      protocol::ValveRequest request;
+      reply = sizeof(protocol::Ack);
+      return decode(payload, length, request) &&
+             request.target < protocol::NUM_VALVES &&
+             (!latched || request.duration_sec == 0);
+    }
+    case protocol::Type::VOLUME: {
+      protocol::VolumeRequest request;
+      reply = sizeof(protocol::Ack);
+      return !latched && decode(payload, length, request) &&
+             metered(request.target) && request.volume_ml != 0;
+    }
+    case protocol::Type::TELEMETRY: {
+      protocol::TelemetryRequest request;
+      reply = sizeof(protocol::Ack);
+      return decode(payload, length, request) &&
+             request.sensor < protocol::NUM_SENSORS &&
+             request.batch <= Telemetry::MAX_BATCH;
+    }
+    case protocol::Type::PROGRAM: {
+      protocol::ProgramRequest request;
+      Sequencer::Step step;
+      reply = sizeof(protocol::Ack);
+      return !sequencer.running() && decode(payload, length, request) &&
+             request.step < Sequencer::MAX_STEPS &&
+             request.after != request.step && to_step(request, step);
+    }
+    default:
+      return false;
+  }
+}
+
+// Requests that can be sent to another unit over the link.
+auto forwardable(protocol::Type type) -> bool {
+  return type != protocol::Type::MODE && type != protocol::Type::BATCH &&
+         type != protocol::Type::FORWARD;
+}
+
+template <size_t index>
+auto declare_valve() -> void {
+  bi_decl(bi_1pin_with_name(VALVES[index].pin, VALVES[index].name));
+}
+
+template <size_t index>
+auto declare_sensor() -> void {
+  bi_decl(bi_1pin_with_name(SENSORS[index].pin, SENSORS[index].name));
+}
+
+auto to_request(uint8_t index,
+                const Sequencer::Step &step) -> protocol::ProgramRequest {
+  return protocol::ProgramRequest{index, step.valve, step.offset_sec,
+                                  step.duration_sec, step.after};
+}
+
+}  // namespace
+
+App::App(Framework &framework)
+    : framework_{framework},
+      calibration_{},
+      recorded_valves_{0},
+      recorded_{},
+      seen_{},
+      polled_{},
+      timeout_{0},
+      heartbeat_ms_{0},
+      heartbeat_due_{0},
+      failsafe_{},
+      mode_{protocol::Mode::TEXT},
+      address_{protocol::LINK_BROADCAST} {}
+
 auto App::init() -> void {
   bi_decl(bi_1pin_with_name(indicator_.get_red_pin(), "LED_RED"));
   bi_decl(bi_1pin_with_name(indicator_.get_grn_pin(), "LED_GRN"));
   bi_decl(bi_1pin_with_name(indicator_.get_blu_pin(), "LED_BLU"));
   indicator_.init(false);
 
-  bi_decl(bi_1pin_with_name(valve0_.get_pin(), "VALVE0"));
-  valve0_.init();
+  valves_.for_each([](auto &valve, auto index) {
+    declare_valve<index>();
+    valve.init();
+  });
+  valve_outputs_.init();
+  bi_decl(bi_2pins_with_func(UART_RX_PIN, UART_TX_PIN, GPIO_FUNC_UART));
 
-  bi_decl(bi_1pin_with_name(valve0_.get_pin(), "VALVE1"));
-  valve1_.init();
-
-  bi_decl(bi_1pin_with_name(moisture0_.get_pin(), "MOISTURE0"));
-  moisture0_.init();
-
-  bi_decl(bi_1pin_with_name(moisture1_.get_pin(), "MOISTURE1"));
-  moisture1_.init();
-
-  bi_decl(bi_1pin_with_name(flow0_.get_pin(), "FLOW0"));
-  flow0_.init();
-
-  bi_decl(bi_1pin_with_name(flow1_.get_pin(), "FLOW1"));
-  flow1_.init();
+  auto &scheduler = framework_.scheduler();
+  sensors_.for_each([&scheduler](auto &sensor, auto index) {
+    declare_sensor<index>();
+    sensor.init();
+    scheduler.schedule(Task::SENSOR + index, sensor.deadline());
+  });
+  load();
+  auto now = time_us_64();
+  for (uint8_t valve = 0; valve < protocol::NUM_VALVES; ++valve)
+    supervise(valve, now);
+  // Not after watchdog_reboot(), that's a reset asked for.
+  if (watchdog_enable_caused_reboot()) trip(protocol::Failsafe::WATCHDOG, 0);
+  watchdog_enable(WATCHDOG_MS, true);
+  scheduler.schedule(Task::WATCHDOG, now);
+  heard(now);
 }
 
 auto App::periodic() -> void {
-  indicator_.periodic();
-  valve0_.periodic();
-  valve1_.periodic();
-  moisture0_.periodic();
-  moisture1_.periodic();
-  flow0_.periodic();
-  flow1_.periodic();
-  auto valve0_on = valve0_.get();
-  auto valve1_on = valve1_.get();
-  if (valve0_on && valve1_on) {
-    indicator_.set_state(State::BOTH_VALVES_ON);
-  } else if (valve0_on) {
+  auto &scheduler = framework_.scheduler();
+  auto now = time_us_64();
+  // Run everything that is due, earliest deadline first.
+  for (auto id = scheduler.pop(now); id != Scheduler::NONE;
+       id = scheduler.pop(now)) {
+    if (id >= Task::VALVE && id < Task::FLOW) {
+      valves_.at(id - Task::VALVE, [&](auto &valve) {
+        valve.periodic(now);
+        scheduler.schedule(id, valve.deadline());
+      });
+      supervise(id - Task::VALVE, now);
+    } else if (id >= Task::FLOW && id < Task::SENSOR) {
+      supervise(id - Task::FLOW, now);
+    } else if (id >= Task::SENSOR && id < Task::TELEMETRY) {
+      sensors_.at(id - Task::SENSOR, [&](auto &sensor) {
+        sensor.periodic(now);
+        scheduler.schedule(id, sensor.deadline());
+      });
+      record(id - Task::SENSOR);
+    } else if (id == Task::TELEMETRY) {
+      stream(now);
+    } else if (id == Task::SEQUENCER) {
+      sequence(now);
+    } else if (id == Task::LINK) {
+      service_link(now);
+    } else if (id == Task::WATCHDOG) {
+      // Only fed while tasks are being run.
+      watchdog_update();
+      scheduler.schedule(id, now + WATCHDOG_FEED_US);
+    } else if (id == Task::HEARTBEAT) {
+      trip(protocol::Failsafe::HEARTBEAT, heartbeat_due_);
+    }
+    // Task::TIMEOUT is only here to wake us up to show the disconnected
+    // state.
+  }
+  update_valves();
+  framework_.stats().ring(Framework::API_USB_CH, output.high_water(),
+                          output.dropped());
+  // Valve 0 alone, any other one valve alone or more than one.
+  auto shown = indicator_.get_state();
+  auto on = valves_on();
+  if (latched()) {
+    indicator_.set_state(State::FAILSAFE);
+  } else if (on == 0x01) {
     indicator_.set_state(State::VALVE0_ON);
-  } else if (valve1_on) {
+  } else if (on != 0 && (on & (on - 1)) == 0) {
     indicator_.set_state(State::VALVE1_ON);
-  } else if (timeout_ < time_us_64()) {
+  } else if (on != 0) {
+    indicator_.set_state(State::BOTH_VALVES_ON);
+  } else if (timeout_ <= now) {
     indicator_.set_state(State::DISCONNECTED);
   } else {
     indicator_.set_state(State::CONNECTED);
   }
+  if (indicator_.get_state() != shown) status_cache.stale = true;
 }
 
 auto App::perform_command() -> void {
   auto &console = framework_.console();
+  heard(time_us_64());
   switch (parser.command) {
     case Parser::Command::STATUS:
-      respond(
-          "R{\"l\":%d,\"v0\":%d,\"v1\":%d,\"m0\":%c%d,\"m1\":%c%d,\"m2\":%c%d,"
-          "\"f0\":%c%d,\"f1\":%c%d}\r\n",
-          indicator_.get_state(), valve0_.get(), valve1_.get(),
-          (moisture0_.updated()) ? ' ' : '-', moisture0_.value(),
-          (moisture1_.updated()) ? ' ' : '-', moisture1_.value(),
-          (moisture1_.updated()) ? ' ' : '-', 0, (flow0_.updated()) ? ' ' : '-',
-          flow0_.value(), (flow1_.updated()) ? ' ' : '-', flow1_.value());
+      // R{"l":state,"v0":on,...,"m0":edges,...}, see send_status().
+      send_status();
+      break;
+    case Parser::Command::STATUS_SINCE: {
+      // q<generation>, R{"q":generation,"l":state,"a":faults,"v0":on,...,
+      // "m0":Hz,...} or R{} while the status hasn't changed from it, see
+      // refresh_status().
+      refresh_status();
+      if (parser.values[0] == status_cache.snapshot.generation) {
+        respond<"R{}\r\n">();
+      } else {
+        output.write(status_cache.text.data(), status_cache.text.length());
+      }
+    } break;
+    case Parser::Command::HEARTBEAT:
+      // k<clear>, K<failsafe> with the one still latched.
+      if (parser.values[0] != 0) clear_failsafe();
+      respond<"K%u\r\n">(static_cast<unsigned>(failsafe_.latched));
       break;
+    case Parser::Command::STATS: {
+      // I{"n":passes,"min":us,"max":us,"h":[...],"t":[ms,...],"in":[...],
+      // "out":[...],"hw":[...],"drop":[...],"slow":ms,"wake":n}, channels
+      // api then console.
+      auto &stats = framework_.stats();
+      respond<"I{\"n\":%u,\"min\":%u,\"max\":%u,\"h\":[">(
+          stats.passes(), stats.min_us(), stats.max_us());
+      for (size_t bucket = 0; bucket < Stats::NUM_BUCKETS; ++bucket)
+        respond<"%s%u">(bucket ? "," : "", stats.histogram(bucket));
+      respond<"],\"t\":[">();
+      for (uint8_t component = 0; component < Stats::NUM_COMPONENTS;
+           ++component) {
+        auto time_ms = stats.time_us(static_cast<Stats::Component>(component)) /
+                       1000;
+        respond<"%s%llu">(component ? "," : "", time_ms);
+      }
+      const auto &api = stats.channel(Framework::API_USB_CH);
+      const auto &debug = stats.channel(Framework::DEBUG_USB_CH);
+      respond<"],\"in\":[%u,%u],\"out\":[%u,%u]">(api.in, debug.in, api.out,
+                                                   debug.out);
+      respond<",\"hw\":[%u,%u],\"drop\":[%u,%u]">(
+          api.high_water, debug.high_water, api.dropped, debug.dropped);
+      auto &power = framework_.power();
+      respond<",\"slow\":%llu,\"wake\":%u}\r\n">(
+          power.slow_us(time_us_64()) / 1000, power.wakes());
+    } break;
     case Parser::Command::RESET:
-      console.printf("Reset value: %d\r\n", parser.values[0]);
+      console.printf("Reset value: %u\r\n", parser.values[0]);
       if (parser.values[0] == 5511) {
         // Reset to allow loading new image as if BOOTSEL was being held down.
         reset_usb_boot(0, 0);
       } else if (parser.values[0] == 1033) {
         watchdog_reboot(0, 0, RESET_DELAY_MS);
       } else {
-        respond("Er%d\r\n", parser.values[0]);
+        respond("Er%u\r\n", parser.values[0]);
       }
       break;
     case Parser::Command::VALVE:
-      console.printf("Valve target: %d pulse: %d\r\n", parser.target,
+      console.printf("Valve target: %d pulse: %u\r\n", parser.target,
                      parser.values[0]);
-      if (parser.target == 0) {
-        valve0_.pulse(parser.values[0]);
-        respond("AV0\r\n");
-      } else if (parser.target == 1) {
-        valve1_.pulse(parser.values[0]);
-        respond("AV1\r\n");
+      if (pulse(parser.target, parser.values[0], time_us_64())) {
+        respond<"AV%d\r\n">(parser.target);
+      } else {
+        respond<"Ev%d\r\n">(parser.target);
+      }
+      break;
+    case Parser::Command::VOLUME:
+      // w<target>:<volume_ml>[,<max_sec>]
+      if (parser.values[1] <= 0xffff &&
+          meter(parser.target, parser.values[0], parser.values[1])) {
+        respond<"AW%d\r\n">(parser.target);
+      } else {
+        respond<"Ew%d\r\n">(parser.target);
+      }
+      break;
+    case Parser::Command::MODE:
+      if (parser.values[0] == static_cast<uint32_t>(protocol::Mode::BINARY)) {
+        respond("AM%u\r\n", parser.values[0]);
+        mode_ = protocol::Mode::BINARY;
+        frame_.reset();
+      } else if (parser.values[0] ==
+                 static_cast<uint32_t>(protocol::Mode::TEXT)) {
+        respond("AM%u\r\n", parser.values[0]);
+      } else {
+        respond("Em%u\r\n", parser.values[0]);
+      }
+      break;
+    case Parser::Command::HISTORY:
+      send_history(parser.values[0]);
+      break;
+    case Parser::Command::CONFIG: {
+      // c<key> reads a setting, c<key>:<value> sets it.
+      auto key = parser.values[0];
+      uint32_t value = 0;
+      if (key > 0xff) {
+        respond<"Ec%u\r\n">(key);
+      } else if (parser.count() > 1) {
+        if (configure(static_cast<uint8_t>(key), parser.values[1])) {
+          respond<"AC%u\r\n">(key);
+        } else {
+          respond<"Ec%u\r\n">(key);
+        }
+      } else if (setting(static_cast<uint8_t>(key), value)) {
+        respond<"C%u:%u\r\n">(key, value);
       } else {
-        respond("Ev%d\r\n", parser.target);
+        respond<"Ec%u\r\n">(key);
       }
+    } break;
+    case Parser::Command::PROGRAM: {
+      Sequencer::Step step;
+      if (to_step(parser, step) && program(parser.target, step)) {
+        respond<"AP%d\r\n">(parser.target);
+      } else {
+        respond<"Ep%d\r\n">(parser.target);
+      }
+    } break;
+    case Parser::Command::RUN:
+      if (parser.values[0] <= static_cast<uint32_t>(protocol::Run::CLEAR) &&
+          run(static_cast<protocol::Run>(parser.values[0]))) {
+        respond<"AG%u\r\n">(parser.values[0]);
+      } else {
+        respond<"Eg%u\r\n">(parser.values[0]);
+      }
+      break;
+    case Parser::Command::TELEMETRY:
+      if (subscribe(parser.target, parser.values[0],
+                    static_cast<uint8_t>(parser.values[1]))) {
+        respond<"AT%d\r\n">(parser.target);
+      } else {
+        respond<"Et%d\r\n">(parser.target);
+      }
+      break;
+    default:
       break;
   }
 }
 
+auto App::perform_frame(protocol::Type type, const uint8_t *payload,
+                        size_t length) -> void {
+  heard(time_us_64());
+  switch (type) {
+    case protocol::Type::STATUS: {
+      if (length != 0) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+        break;
+      }
+      refresh_status();
+      const auto &status = status_cache.snapshot.status;
+      respond_frame(protocol::Type::STATUS_REPLY, &status, sizeof(status));
+    } break;
+    case protocol::Type::HEARTBEAT: {
+      protocol::HeartbeatRequest request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+        break;
+      }
+      if (request.clear) clear_failsafe();
+      respond_ack(type, static_cast<uint8_t>(failsafe_.latched));
+    } break;
+    case protocol::Type::STATUS_SINCE: {
+      protocol::StatusSince request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+        break;
+      }
+      refresh_status();
+      const auto &snapshot = status_cache.snapshot;
+      auto size = (request.generation == snapshot.generation)
+                      ? 0
+                      : sizeof(snapshot);
+      respond_frame(protocol::Type::STATUS_SINCE_REPLY, &snapshot, size);
+    } break;
+    case protocol::Type::STATS: {
+      if (length != 0) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+        break;
+      }
+      auto &stats = framework_.stats();
+      protocol::StatsReply reply;
+      reply.passes = stats.passes();
+      reply.min_us = stats.min_us();
+      reply.max_us = stats.max_us();
+      for (size_t bucket = 0; bucket < Stats::NUM_BUCKETS; ++bucket)
+        reply.histogram[bucket] = stats.histogram(bucket);
+      for (uint8_t component = 0; component < Stats::NUM_COMPONENTS;
+           ++component) {
+        reply.time_ms[component] = static_cast<uint32_t>(
+            stats.time_us(static_cast<Stats::Component>(component)) / 1000);
+      }
+      const uint8_t channels[] = {Framework::API_USB_CH,
+                                  Framework::DEBUG_USB_CH};
+      for (size_t i = 0; i < 2; ++i) {
+        const auto &channel = stats.channel(channels[i]);
+        reply.in[i] = channel.in;
+        reply.out[i] = channel.out;
+        reply.high_water[i] = channel.high_water;
+        reply.dropped[i] = channel.dropped;
+      }
+      respond_frame(protocol::Type::STATS_REPLY, &reply, sizeof(reply));
+    } break;
+    case protocol::Type::SAMPLE: {
+      protocol::SampleRequest request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else if (request.sensor >= protocol::NUM_SENSORS) {
+        respond_nak(type, protocol::Error::BAD_TARGET);
+      } else {
+        auto reply = sample(request.sensor);
+        respond_frame(protocol::Type::SAMPLE_REPLY, &reply, sizeof(reply));
+      }
+    } break;
+    case protocol::Type::VALVE: {
+      protocol::ValveRequest request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else if (latched() && request.duration_sec != 0) {
+        respond_nak(type, protocol::Error::BUSY);
+      } else if (pulse(request.target, request.duration_sec, time_us_64())) {
+        respond_ack(type, request.target);
+      } else {
+        respond_nak(type, protocol::Error::BAD_TARGET);
+      }
+    } break;
+    case protocol::Type::VOLUME: {
+      protocol::VolumeRequest request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else if (!metered(request.target)) {
+        respond_nak(type, protocol::Error::BAD_TARGET);
+      } else if (latched()) {
+        respond_nak(type, protocol::Error::BUSY);
+      } else if (!meter(request.target, request.volume_ml, request.max_sec)) {
+        respond_nak(type, protocol::Error::BAD_VALUE);
+      } else {
+        respond_ack(type, request.target);
+      }
+    } break;
+    case protocol::Type::RESET: {
+      protocol::ResetRequest request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else if (request.value == 5511) {
+        reset_usb_boot(0, 0);
+      } else if (request.value == 1033) {
+        watchdog_reboot(0, 0, RESET_DELAY_MS);
+      } else {
+        respond_nak(type, protocol::Error::BAD_VALUE);
+      }
+    } break;
+    case protocol::Type::MODE: {
+      protocol::ModeRequest request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else if (request.mode == protocol::Mode::TEXT) {
+        respond_ack(type, static_cast<uint8_t>(request.mode));
+        mode_ = protocol::Mode::TEXT;
+        parser.reset();
+      } else if (request.mode == protocol::Mode::BINARY) {
+        respond_ack(type, static_cast<uint8_t>(request.mode));
+      } else {
+        respond_nak(type, protocol::Error::BAD_VALUE);
+      }
+    } break;
+    case protocol::Type::TELEMETRY: {
+      protocol::TelemetryRequest request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else if (request.sensor >= protocol::NUM_SENSORS) {
+        respond_nak(type, protocol::Error::BAD_TARGET);
+      } else if (!subscribe(request.sensor, request.interval_ms,
+                            request.batch)) {
+        respond_nak(type, protocol::Error::BAD_VALUE);
+      } else {
+        respond_ack(type, request.sensor);
+      }
+    } break;
+    case protocol::Type::HISTORY: {
+      protocol::HistoryRequest request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else {
+        send_history(request.sequence);
+      }
+    } break;
+    case protocol::Type::CONFIG: {
+      protocol::ConfigRequest request;
+      uint32_t value = 0;
+      if (length == sizeof(request.key)) {
+        if (setting(payload[0], value)) {
+          auto reply = protocol::ConfigReply{payload[0], value};
+          respond_frame(protocol::Type::CONFIG_REPLY, &reply, sizeof(reply));
+        } else {
+          respond_nak(type, protocol::Error::BAD_TARGET);
+        }
+      } else if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else if (!configure(request.key, request.value)) {
+        respond_nak(type, protocol::Error::BAD_VALUE);
+      } else {
+        respond_ack(type, request.key);
+      }
+    } break;
+    case protocol::Type::FORWARD:
+      perform_forward(payload, length);
+      break;
+    case protocol::Type::PROGRAM: {
+      protocol::ProgramRequest request;
+      Sequencer::Step step;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else if (!to_step(request, step) || !program(request.step, step)) {
+        respond_nak(type, protocol::Error::BAD_VALUE);
+      } else {
+        respond_ack(type, request.step);
+      }
+    } break;
+    case protocol::Type::RUN: {
+      protocol::RunRequest request;
+      if (!decode(payload, length, request)) {
+        respond_nak(type, protocol::Error::BAD_LENGTH);
+      } else if (!run(request.action)) {
+        respond_nak(type, protocol::Error::BAD_VALUE);
+      } else {
+        respond_ack(type, static_cast<uint8_t>(request.action));
+      }
+    } break;
+    default:
+      respond_nak(type, protocol::Error::UNKNOWN_TYPE);
+      break;
+  }
+}
+
+auto App::pulse(uint8_t target, unsigned duration_sec, uint64_t now) -> bool {
+  if (target >= protocol::NUM_VALVES) return false;
+  if (latched() && duration_sec != 0) return false;
+  auto &scheduler = framework_.scheduler();
+  valves_.at(target, [&](auto &valve) {
+    valve.pulse(duration_sec, now);
+    scheduler.schedule(Task::VALVE + target, valve.deadline());
+  });
+  // A new command clears any fault and ends metering.
+  supervise(target, now, true);
+  return true;
+}
+
+auto App::meter(uint8_t target, uint32_t volume_ml, unsigned max_sec) -> bool {
+  if (latched() || !metered(target) || volume_ml == 0) return false;
+  auto &config = VALVES[target];
+  auto pulses = volume_ml;
+  if (calibration_[target] != 0) {
+    // Rounded up so at least one pulse.
+    auto scaled =
+        (static_cast<uint64_t>(volume_ml) * calibration_[target] + 999) / 1000;
+    if (scaled > UINT32_MAX / 2) return false;
+    pulses = static_cast<uint32_t>(scaled);
+  }
+  pulse(target, (max_sec == 0) ? VOLUME_TIMEOUT_SEC : max_sec, time_us_64());
+  auto count =
+      sensors_.at(config.flow, [](auto &freq) { return freq.count(); });
+  flows_[target].meter(count, pulses);
+  supervise(target, time_us_64());
+  return true;
+}
+
+// Run the valve's flow checks, closing it when metering is done or there is
+// no flow, and record fault changes.
+auto App::supervise(uint8_t valve, uint64_t now, bool clear) -> void {
+  if (!metered(valve)) return;
+  auto &flow = flows_[valve];
+  auto sensor = VALVES[valve].flow;
+  auto before = flow.fault();
+  if (clear) flow.clear();
+  auto open = valves_.at(valve, [](auto &channel) { return channel.get(); });
+  auto [count, rate] = sensors_.at(sensor, [](auto &freq) {
+    return std::pair<uint32_t, uint32_t>{freq.count(), freq.value()};
+  });
+  if (flow.update(open, count, rate, now)) {
+    valves_.at(valve, [](auto &channel) { channel.close(); });
+    framework_.scheduler().cancel(Task::VALVE + valve);
+    flow.update(false, count, rate, now);
+  }
+  if (flow.fault() != before) {
+    status_cache.stale = true;
+    history_.append(protocol::SOURCE_FLOW + valve,
+                    static_cast<uint32_t>(flow.fault()),
+                    static_cast<uint32_t>(now / 1000));
+  }
+  framework_.scheduler().schedule(Task::FLOW + valve, flow.deadline());
+}
+
+// A request, pushing the heartbeat deadline back.
+auto App::heard(uint64_t now) -> void {
+  if (heartbeat_ms_ == 0 || latched()) return;
+  heartbeat_due_ = now + (heartbeat_ms_ * 1000ULL);
+  framework_.scheduler().schedule(Task::HEARTBEAT, heartbeat_due_);
+}
+
+// Close every valve and stop the program, then latch the failsafe. The
+// latency is from due, when the failsafe should have acted, to the valve
+// outputs being written.
+auto App::trip(protocol::Failsafe reason, uint64_t due) -> void {
+  run(protocol::Run::STOP);
+  auto &scheduler = framework_.scheduler();
+  valves_.for_each([&scheduler](auto &valve, auto index) {
+    valve.close();
+    scheduler.cancel(Task::VALVE + index);
+  });
+  update_valves();
+  auto now = time_us_64();
+  uint32_t latency_us = 0;
+  if (due != 0) {
+    latency_us = static_cast<uint32_t>(now - due);
+    if (latency_us > failsafe_.max_latency_us)
+      failsafe_.max_latency_us = latency_us;
+  }
+  failsafe_.latched = reason;
+  ++failsafe_.trips;
+  history_.append(protocol::SOURCE_FAILSAFE + static_cast<uint8_t>(reason),
+                  latency_us, static_cast<uint32_t>(now / 1000));
+  status_cache.stale = true;
+  framework_.store().put(protocol::KEY_FAILSAFE, failsafe_);
+}
+
+auto App::clear_failsafe() -> void {
+  if (!latched()) return;
+  auto now = time_us_64();
+  failsafe_.latched = protocol::Failsafe::NONE;
+  history_.append(protocol::SOURCE_FAILSAFE, 0,
+                  static_cast<uint32_t>(now / 1000));
+  status_cache.stale = true;
+  framework_.store().put(protocol::KEY_FAILSAFE, failsafe_);
+  heard(now);
+}
+
+auto App::faults() -> uint16_t {
+  uint16_t faults = 0;
+  for (uint8_t valve = 0; valve < protocol::NUM_VALVES; ++valve) {
+    if (flows_[valve].fault() != protocol::Fault::NONE) faults |= 1u << valve;
+  }
+  return faults;
+}
+
+// The q reply and the binary status. Sensors are shown to three places in Hz,
+// marked '-' if not updated since the last generation. Faults is a bit per
+// valve with a flow fault.
+auto App::refresh_status() -> void {
+  // Valves are checked here as commands change them between passes.
+  auto valves = valves_on();
+  if (!status_cache.stale && valves == status_cache.snapshot.status.valves)
+    return;
+  status_cache.stale = false;
+  auto &snapshot = status_cache.snapshot;
+  if (++snapshot.generation == 0) snapshot.generation = 1;
+  auto &status = snapshot.status;
+  status.indicator = indicator_.get_state();
+  status.valves = valves;
+  status.faults = faults();
+  status.sensors = protocol::NUM_SENSORS;
+  for (uint8_t sensor = 0; sensor < protocol::NUM_SENSORS; ++sensor) {
+    status.samples[sensor] = sample(sensor);
+  }
+  auto &text = status_cache.text;
+  text.clear();
+  text.print<"R{\"q\":%u,\"l\":%d,\"a\":%u">(snapshot.generation,
+                                             status.indicator, status.faults);
+  for (unsigned valve = 0; valve < protocol::NUM_VALVES; ++valve) {
+    text.print<",\"v%u\":%d">(valve, (status.valves >> valve) & 1);
+  }
+  for (uint8_t sensor = 0; sensor < protocol::NUM_SENSORS; ++sensor) {
+    const auto &latest = status.samples[sensor];
+    auto mark = (latest.flags & protocol::SAMPLE_UPDATED) ? ' ' : '-';
+    text.print<",\"%s\":%c%u.%03u">(SENSORS[sensor].key, mark,
+                                    latest.value / 1000, latest.value % 1000);
+  }
+  text.print<"}\r\n">();
+}
+
+// Sensors are shown as the edges their last rate gives over their default
+// window, so the numbers mean what they always have, and marked '-' if not
+// updated since the last s reply. Rendered from the status generation and
+// only again when it or the marks change, so polls in between are copies.
+auto App::send_status() -> void {
+  refresh_status();
+  uint16_t marks = 0;
+  sensors_.for_each([this, &marks](const auto &freq, auto sensor) {
+    if (polled_[sensor] != freq.sequence()) marks |= 1u << sensor;
+    polled_[sensor] = freq.sequence();
+  });
+  auto &cache = status_cache;
+  if (cache.poll.length() == 0 ||
+      cache.poll_generation != cache.snapshot.generation ||
+      cache.poll_marks != marks) {
+    cache.poll_generation = cache.snapshot.generation;
+    cache.poll_marks = marks;
+    const auto &status = cache.snapshot.status;
+    auto &text = cache.poll;
+    text.clear();
+    text.print<"R{\"l\":%d">(status.indicator);
+    for (unsigned valve = 0; valve < protocol::NUM_VALVES; ++valve) {
+      text.print<",\"v%u\":%d">(valve, (status.valves >> valve) & 1);
+    }
+    auto show = [&](const char *key, uint8_t sensor) {
+      if (sensor == NO_SENSOR) {
+        text.print<",\"%s\":-0">(key);
+        return;
+      }
+      // From the rate, so it is over the default window whatever window it
+      // was measured over.
+      auto edges = (static_cast<uint64_t>(status.samples[sensor].value) *
+                        SENSORS[sensor].window_ms +
+                    500000) /
+                   1000000;
+      text.print<",\"%s\":%c%u">(key, (marks & (1u << sensor)) ? ' ' : '-',
+                                   static_cast<unsigned>(edges));
+    };
+    for (auto key : STATUS_KEYS) show(key, keyed(key));
+    for (uint8_t sensor = 0; sensor < NUM_SENSORS; ++sensor) {
+      if (unkeyed() & (1u << sensor)) show(SENSORS[sensor].key, sensor);
+    }
+    text.print<"}\r\n">();
+  }
+  output.write(cache.poll.data(), cache.poll.length());
+}
+
+auto App::sample(uint8_t sensor) -> protocol::Sample {
+  uint32_t sequence = 0;
+  auto latest = reading(sensor, sequence);
+  protocol::Sample result{latest.value, sensor, 0};
+  if (sensor < protocol::NUM_SENSORS && seen_[sensor] != sequence) {
+    seen_[sensor] = sequence;
+    result.flags = protocol::SAMPLE_UPDATED;
+  }
+  return result;
+}
+
+auto App::reading(uint8_t sensor, uint32_t &sequence) -> protocol::Reading {
+  if (sensor >= protocol::NUM_SENSORS) {
+    sequence = 0;
+    return protocol::Reading{0, 0, 0, sensor};
+  }
+  return sensors_.at(sensor, [&](const auto &freq) {
+    sequence = freq.sequence();
+    return protocol::Reading{static_cast<uint32_t>(freq.time() / 1000),
+                             freq.value(), static_cast<uint16_t>(sequence),
+                             sensor};
+  });
+}
+
+// Only changes, a host takes a sensor as unchanged until its next record.
+// The first window is always recorded.
+auto App::record(uint8_t sensor) -> void {
+  uint32_t sequence = 0;
+  auto latest = reading(sensor, sequence);
+  if (sequence == 1 || latest.value != recorded_[sensor]) {
+    recorded_[sensor] = latest.value;
+    history_.append(sensor, latest.value, latest.time_ms);
+  }
+  status_cache.stale = true;
+}
+
+// Write every valve changed since the last call in one go, so valves changed
+// in the same pass switch on the same clock, and record the changes.
+auto App::update_valves() -> void {
+  auto valves = valves_on();
+  auto changed = valves ^ recorded_valves_;
+  if (changed == 0) return;
+  valve_outputs_.put(changed, valves);
+  auto time_ms = static_cast<uint32_t>(time_us_64() / 1000);
+  for (uint8_t valve = 0; valve < protocol::NUM_VALVES; ++valve) {
+    if (changed & (1u << valve))
+      history_.append(protocol::SOURCE_VALVE + valve, (valves >> valve) & 1u,
+                      time_ms);
+  }
+  recorded_valves_ = valves;
+}
+
+auto App::valves_on() -> uint16_t {
+  uint16_t on = 0;
+  valves_.for_each([&on](auto &valve, auto index) {
+    if (valve.get()) on |= 1u << index;
+  });
+  return on;
+}
+
+// Any valve on that isn't due to shut off by now, what an exclusive program
+// step waits for.
+auto App::staying_on(uint64_t now) -> bool {
+  bool on = false;
+  valves_.for_each([&on, now](auto &valve, auto) {
+    if (valve.get() && (valve.deadline() == 0 || valve.deadline() > now))
+      on = true;
+  });
+  return on;
+}
+
+// Everything from a sequence number on, as much as the output has room for.
+// The host asks again from the last sequence seen plus one until there are
+// none.
+auto App::send_history(uint32_t from) -> void {
+  if (mode_ == protocol::Mode::BINARY) {
+    constexpr size_t PER_FRAME =
+        (Frame::MAX_PAYLOAD - sizeof(protocol::HistoryHeader)) /
+        sizeof(protocol::Record);
+    constexpr size_t FRAME_SIZE = Frame::MAX_PAYLOAD + Frame::OVERHEAD;
+    struct __attribute__((packed)) {
+      protocol::HistoryHeader header;
+      protocol::Record records[PER_FRAME];
+    } data;
+    // Always at least one frame, maybe empty. Each carries on from where
+    // the last stopped.
+    auto cursor = history_.begin();
+    do {
+      data.header.first = history_.next_sequence();
+      size_t count = 0;
+      history_.read(from, cursor, [&](const auto &record) {
+        if (count == PER_FRAME) return false;
+        if (count == 0) data.header.first = record.sequence;
+        data.records[count++] =
+            protocol::Record{record.time_ms, record.value, record.source};
+        return true;
+      });
+      auto length = sizeof(data.header) + (count * sizeof(protocol::Record));
+      if (!respond_frame(protocol::Type::HISTORY_DATA, &data, length)) break;
+      if (count < PER_FRAME) break;
+    } while (output.room() >= FRAME_SIZE);
+  } else {
+    // H[[sequence,time_ms,source,value],...]
+    constexpr size_t TAIL = 3;
+    if (unreserved() < TAIL + 2) return;
+    respond<"H[">();
+    bool first = true;
+    history_.read(from, [&](const auto &record) {
+      if (unreserved() < MAX_RECORD_TEXT + TAIL) return false;
+      respond<"%s[%u,%u,%u,%u]">(first ? "" : ",", record.sequence,
+                                 record.time_ms, record.source, record.value);
+      first = false;
+      return true;
+    });
+    respond<"]\r\n">();
+  }
+}
+
+// Stored before it is applied, so a value that can't be kept isn't used.
+auto App::configure(uint8_t key, uint32_t value) -> bool {
+  if (key == protocol::KEY_FAILSAFE) {
+    // Can only be cleared, trip() keeps the state.
+    if (value != 0) return false;
+    clear_failsafe();
+    return true;
+  }
+  if (!valid_setting(key, value) || !framework_.store().put(key, value))
+    return false;
+  if (key >= protocol::KEY_WINDOW &&
+      key < protocol::KEY_WINDOW + protocol::NUM_SENSORS) {
+    uint8_t sensor = key - protocol::KEY_WINDOW;
+    auto &scheduler = framework_.scheduler();
+    sensors_.at(sensor, [&](auto &freq) {
+      freq.set_window(value);
+      scheduler.schedule(Task::SENSOR + sensor, freq.deadline());
+    });
+  } else if (key >= protocol::KEY_CALIBRATION &&
+             key < protocol::KEY_CALIBRATION + protocol::NUM_VALVES) {
+    calibration_[key - protocol::KEY_CALIBRATION] = value;
+  } else if (key == protocol::KEY_LINK) {
+    // LINK_BROADCAST turns the link off.
+    address_ = static_cast<uint8_t>(value);
+    if (linked()) {
+      link_.init(uart_get_instance(UART_INDEX), UART_TX_PIN, UART_RX_PIN,
+                 UART_BAUD);
+      framework_.scheduler().schedule(Task::LINK, time_us_64());
+    } else {
+      framework_.scheduler().cancel(Task::LINK);
+    }
+  } else if (key == protocol::KEY_HEARTBEAT) {
+    heartbeat_ms_ = value;
+    if (value == 0) framework_.scheduler().cancel(Task::HEARTBEAT);
+    heard(time_us_64());
+  }
+  return true;
+}
+
+auto App::setting(uint8_t key, uint32_t &value) -> bool {
+  if (key >= protocol::KEY_WINDOW &&
+      key < protocol::KEY_WINDOW + protocol::NUM_SENSORS) {
+    value = sensors_.at(key - protocol::KEY_WINDOW,
+                        [](const auto &freq) { return freq.window(); });
+  } else if (key >= protocol::KEY_CALIBRATION &&
+             key < protocol::KEY_CALIBRATION + protocol::NUM_VALVES) {
+    value = calibration_[key - protocol::KEY_CALIBRATION];
+  } else if (key == protocol::KEY_LINK) {
+    value = address_;
+  } else if (key == protocol::KEY_HEARTBEAT) {
+    value = heartbeat_ms_;
+  } else if (key == protocol::KEY_FAILSAFE) {
+    value = static_cast<uint32_t>(failsafe_.latched);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+// Settings and program steps from flash, over the defaults in app_config.h.
+auto App::load() -> void {
+  auto &store = framework_.store();
+  auto &scheduler = framework_.scheduler();
+  sensors_.for_each([&](auto &freq, auto index) {
+    uint32_t window_ms = 0;
+    if (store.get(protocol::KEY_WINDOW + index, window_ms) && window_ms != 0 &&
+        window_ms <= MAX_WINDOW_MS) {
+      freq.set_window(window_ms);
+      scheduler.schedule(Task::SENSOR + index, freq.deadline());
+    }
+  });
+  for (uint8_t valve = 0; valve < protocol::NUM_VALVES; ++valve) {
+    calibration_[valve] = VALVES[valve].pulses_per_litre;
+    store.get(protocol::KEY_CALIBRATION + valve, calibration_[valve]);
+  }
+  uint32_t address = 0;
+  if (store.get(protocol::KEY_LINK, address))
+    configure(protocol::KEY_LINK, address);
+  uint32_t heartbeat_ms = 0;
+  if (store.get(protocol::KEY_HEARTBEAT, heartbeat_ms) &&
+      heartbeat_ms <= MAX_HEARTBEAT_MS)
+    heartbeat_ms_ = heartbeat_ms;
+  // Still latched from before the reset.
+  store.get(protocol::KEY_FAILSAFE, failsafe_);
+  for (uint8_t index = 0; index < Sequencer::MAX_STEPS; ++index) {
+    protocol::ProgramRequest request;
+    Sequencer::Step step;
+    if (store.get(protocol::KEY_STEP + index, request) &&
+        to_step(request, step))
+      sequencer_.set(index, step);
+  }
+}
+
+auto App::program(uint8_t index, const Sequencer::Step &step) -> bool {
+  if (!sequencer_.set(index, step)) return false;
+  framework_.store().put(protocol::KEY_STEP + index, to_request(index, step));
+  return true;
+}
+
+// Stop, start or clear the program.
+auto App::run(protocol::Run action) -> bool {
+  auto now = time_us_64();
+  auto pulse = [this, now](uint8_t valve, unsigned duration_sec) {
+    this->pulse(valve, duration_sec, now);
+  };
+  auto any_on = [this, now] { return staying_on(now); };
+  bool result = true;
+  switch (action) {
+    case protocol::Run::STOP:
+      sequencer_.stop(pulse);
+      break;
+    case protocol::Run::START:
+    case protocol::Run::START_EXCLUSIVE:
+      result = !latched() &&
+               sequencer_.start(now, action == protocol::Run::START_EXCLUSIVE);
+      if (result) sequencer_.periodic(now, pulse, any_on);
+      break;
+    case protocol::Run::CLEAR:
+      result = !sequencer_.running();
+      sequencer_.clear();
+      if (result) {
+        for (uint8_t index = 0; index < Sequencer::MAX_STEPS; ++index)
+          framework_.store().erase(protocol::KEY_STEP + index);
+      }
+      break;
+    default:
+      result = false;
+      break;
+  }
+  framework_.scheduler().schedule(Task::SEQUENCER, sequencer_.deadline());
+  return result;
+}
+
+auto App::sequence(uint64_t now) -> void {
+  sequencer_.periodic(
+      now,
+      [this, now](uint8_t valve, unsigned duration_sec) {
+        pulse(valve, duration_sec, now);
+      },
+      [this, now] { return staying_on(now); });
+  framework_.scheduler().schedule(Task::SEQUENCER, sequencer_.deadline());
+}
+
+auto App::subscribe(uint8_t sensor, uint32_t interval_ms,
+                    uint8_t batch) -> bool {
+  auto now = time_us_64();
+  if (!telemetry_.subscribe(sensor, interval_ms, batch, now)) return false;
+  framework_.scheduler().schedule(Task::TELEMETRY, telemetry_.deadline());
+  return true;
+}
+
+auto App::stream(uint64_t now) -> void {
+  for (uint8_t sensor = 0; sensor < protocol::NUM_SENSORS; ++sensor) {
+    if (!telemetry_.due(sensor, now)) continue;
+    uint32_t sequence = 0;
+    auto latest = reading(sensor, sequence);
+    telemetry_.add(latest, sequence, now);
+  }
+  if (telemetry_.ready(now)) {
+    auto readings = telemetry_.readings();
+    auto count = telemetry_.count();
+    bool sent = false;
+    if (mode_ == protocol::Mode::BINARY) {
+      sent = respond_frame(protocol::Type::TELEMETRY_DATA, readings,
+                           count * sizeof(protocol::Reading));
+    } else if (output.room() >= (count * MAX_READING_TEXT) + 5) {
+      // D[[sensor,time_ms,sequence,millihertz],...], room checked first so a
+      // line is never cut short.
+      respond<"D[">();
+      for (size_t i = 0; i < count; ++i) {
+        auto &reading = readings[i];
+        respond<"%s[%u,%u,%u,%u]">((i == 0) ? "" : ",", reading.sensor,
+                                   reading.time_ms, reading.sequence,
+                                   reading.value);
+      }
+      sent = respond<"]\r\n">();
+    }
+    if (sent) telemetry_.clear();
+  }
+  auto deadline = telemetry_.deadline();
+  // Readings left queued wait for the output to drain.
+  if (telemetry_.ready(now) && deadline <= now)
+    deadline = now + TELEMETRY_RETRY_DELAY;
+  framework_.scheduler().schedule(Task::TELEMETRY, deadline);
+}
+
 auto App::parse(char c) -> void {
   timeout_ = TIMEOUT_DELAY + time_us_64();
+  if (mode_ == protocol::Mode::BINARY) {
+    if (frame_.parse(static_cast<uint8_t>(c))) {
+      auto type = static_cast<protocol::Type>(frame_.type());
+      if (type == protocol::Type::BATCH) {
+        perform_batch_frame();
+      } else {
+        perform_frame(type, frame_.payload(), frame_.length());
+      }
+    }
+    return;
+  }
+  if (parser.state == Parser::State::COMMAND && c == '[') {
+    if (batch.open) batch.failed = true;
+    batch.open = true;
+    return;
+  }
+  if (parser.state == Parser::State::COMMAND && c == ']') {
+    perform_batch();
+    return;
+  }
   if (parser.parse(c)) {
-    perform_command();
+    if (!batch.open) {
+      perform_command();
+    } else if (batch.count < batch.commands.size()) {
+      batch.commands[batch.count++] = parser;
+    } else {
+      batch.failed = true;
+    }
     parser.reset();
   }
+  if (parser.failed) {
+    parser.failed = false;
+    if (batch.open) batch.failed = true;
+  }
+  // A ']' that ended the last command's value also ends the batch, one that
+  // left a command unfinished fails it.
+  if (c == ']' && batch.open) {
+    if (parser.state != Parser::State::COMMAND) {
+      batch.failed = true;
+      parser.reset();
+    }
+    perform_batch();
+  }
+}
+
+// Reply B<count> then each command's reply, or Eb<index> for the first that
+// would fail (Eb alone if the batch couldn't be parsed) and none are run.
+// Nothing is run unless every command would succeed and all the replies,
+// after a B<count> header, fit in the output as it is, otherwise Eb<index>
+// for the first that wouldn't succeed or Eb for no room.
+auto App::perform_batch() -> void {
+  constexpr size_t HEADER = 5;  // B16\r\n
+  std::array<size_t, Batch::MAX_COMMANDS> replies{};
+  size_t later = 0;
+  if (!batch.open || batch.failed) {
+    respond("Eb\r\n");
+  } else {
+    size_t index = 0;
+    while (index < batch.count && check(batch.commands[index], sequencer_,
+                                        latched(), replies[index]))
+      later += replies[index++];
+    if (index < batch.count) {
+      respond("Eb%u\r\n", static_cast<unsigned>(index));
+    } else if (output.room() < HEADER + later) {
+      respond("Eb\r\n");
+    } else {
+      respond<"B%u\r\n">(static_cast<unsigned>(batch.count));
+      for (index = 0; index < batch.count; ++index) {
+        later -= replies[index];
+        reserved = later;
+        parser = batch.commands[index];
+        perform_command();
+      }
+      reserved = 0;
+      parser.reset();
+    }
+  }
+  batch = Batch{};
+}
+
+// BATCH holds Entry headed requests, run only if all are valid, all the
+// replies fit in one BATCH_REPLY and the output has room for it. Otherwise a
+// NAK and nothing is run.
+auto App::perform_batch_frame() -> void {
+  auto payload = frame_.payload();
+  size_t length = frame_.length();
+  size_t replies = 0;
+  bool valid = true;
+  for (size_t offset = 0; valid && offset < length;) {
+    protocol::Entry entry;
+    valid = offset + sizeof(entry) <= length;
+    if (!valid) break;
+    memcpy(&entry, &payload[offset], sizeof(entry));
+    offset += sizeof(entry);
+    size_t reply = 0;
+    valid = offset + entry.length <= length &&
+            check(entry.type, &payload[offset], entry.length, sequencer_,
+                  latched(), reply);
+    offset += entry.length;
+    replies += sizeof(protocol::Entry) + reply;
+  }
+  if (!valid || replies > sizeof(capture.data)) {
+    respond_nak(protocol::Type::BATCH, valid ? protocol::Error::BAD_LENGTH
+                                             : protocol::Error::BAD_VALUE);
+    return;
+  }
+  if (output.room() < replies + Frame::OVERHEAD) {
+    respond_nak(protocol::Type::BATCH, protocol::Error::BUSY);
+    return;
+  }
+  capture.active = true;
+  capture.length = 0;
+  for (size_t offset = 0; offset < length;) {
+    protocol::Entry entry;
+    memcpy(&entry, &payload[offset], sizeof(entry));
+    offset += sizeof(entry);
+    perform_frame(entry.type, &payload[offset], entry.length);
+    offset += entry.length;
+  }
+  capture.active = false;
+  respond_frame(protocol::Type::BATCH_REPLY, capture.data, capture.length);
+}
+
+// A FORWARD from the host, sent on round the link unless it is for this
+// unit alone.
+auto App::perform_forward(const uint8_t *payload, size_t length) -> void {
+  protocol::Forward header;
+  if (length < sizeof(header)) {
+    respond_nak(protocol::Type::FORWARD, protocol::Error::BAD_LENGTH);
+    return;
+  }
+  memcpy(&header, payload, sizeof(header));
+  if (!linked()) {
+    respond_nak(protocol::Type::FORWARD, protocol::Error::BAD_TARGET);
+    return;
+  }
+  if (!forwardable(header.type)) {
+    respond_nak(protocol::Type::FORWARD, protocol::Error::BAD_VALUE);
+    return;
+  }
+  if (header.address != address_) {
+    uint8_t frame[Frame::MAX_PAYLOAD];
+    header.hops = 0;
+    memcpy(frame, payload, length);
+    memcpy(frame, &header, sizeof(header));
+    if (!send_link(protocol::Type::FORWARD, frame, length)) {
+      respond_nak(protocol::Type::FORWARD, protocol::Error::BUSY);
+      return;
+    }
+  }
+  if (header.address == address_ || header.address == protocol::LINK_BROADCAST)
+    perform_forwarded(header, payload + sizeof(header),
+                      length - sizeof(header), false);
+}
+
+// Perform a forwarded request here, each reply going back as a
+// FORWARD_REPLY from this unit, to the host or on round the link.
+auto App::perform_forwarded(const protocol::Forward &header,
+                            const uint8_t *payload, size_t length,
+                            bool to_link) -> void {
+  capture.active = true;
+  capture.length = 0;
+  perform_frame(header.type, payload, length);
+  capture.active = false;
+  uint8_t reply[Frame::MAX_PAYLOAD];
+  for (size_t offset = 0; offset < capture.length;) {
+    protocol::Entry entry;
+    memcpy(&entry, &capture.data[offset], sizeof(entry));
+    offset += sizeof(entry);
+    auto forward = protocol::Forward{address_, 0, entry.type};
+    auto size = sizeof(forward) + entry.length;
+    if (size <= sizeof(reply)) {
+      memcpy(reply, &forward, sizeof(forward));
+      memcpy(&reply[sizeof(forward)], &capture.data[offset], entry.length);
+      if (to_link) {
+        send_link(protocol::Type::FORWARD_REPLY, reply, size);
+      } else {
+        respond_frame(protocol::Type::FORWARD_REPLY, reply, size);
+      }
+    }
+    offset += entry.length;
+  }
+}
+
+auto App::perform_link_frame(protocol::Type type, const uint8_t *payload,
+                             size_t length) -> void {
+  protocol::Forward header;
+  if (length < sizeof(header)) return;
+  memcpy(&header, payload, sizeof(header));
+  if (type == protocol::Type::FORWARD_REPLY) {
+    // Replies end at the head, only a binary mode host can take them.
+    if (address_ == 0) {
+      if (mode_ == protocol::Mode::BINARY)
+        respond_frame(protocol::Type::FORWARD_REPLY, payload, length);
+      return;
+    }
+  } else if (type == protocol::Type::FORWARD) {
+    // Back at the head a request has been all the way round.
+    if (address_ == 0) return;
+    if ((header.address == address_ ||
+         header.address == protocol::LINK_BROADCAST) &&
+        forwardable(header.type))
+      perform_forwarded(header, payload + sizeof(header),
+                        length - sizeof(header), true);
+    if (header.address == address_) return;
+  } else {
+    return;
+  }
+  if (++header.hops >= protocol::LINK_MAX_HOPS) return;
+  uint8_t frame[Frame::MAX_PAYLOAD];
+  memcpy(frame, payload, length);
+  memcpy(frame, &header, sizeof(header));
+  send_link(type, frame, length);
+}
+
+auto App::send_link(protocol::Type type, const void *payload,
+                    size_t length) -> bool {
+  uint8_t frame[Frame::MAX_PAYLOAD + Frame::OVERHEAD];
+  auto size = Frame::encode(static_cast<uint8_t>(type), payload, length, frame);
+  return link_.write(frame, size);
+}
+
+auto App::service_link(uint64_t now) -> void {
+  if (!linked()) return;
+  link_.poll();
+  for (;;) {
+    auto [data, length] = link_.read_buffer();
+    if (length == 0) break;
+    for (size_t i = 0; i < length; ++i) {
+      if (link_frame_.parse(data[i]))
+        perform_link_frame(static_cast<protocol::Type>(link_frame_.type()),
+                           link_frame_.payload(), link_frame_.length());
+    }
+    link_.read_done(length);
+  }
+  framework_.scheduler().schedule(Task::LINK, now + LINK_POLL_US);
 }
 
 auto App::read_buffer() -> std::pair<uint8_t *, size_t> {
@@ -315,24 +1686,12 @@ auto App::read_done(size_t length) -> void {
     auto c = rx_buffer[i];
     parse(c);
   }
+  update_valves();
+  if (length > 0) framework_.scheduler().schedule(Task::TIMEOUT, timeout_);
 }
 
 auto App::write_buffer() -> std::pair<const char *, size_t> {
-  size_t size = 0;
-  size_t send_index = tx_sent;
-  // If buffer has been wrapped this is true.
-  if (tx_index < tx_sent) {
-    size = sizeof(output_buffer) - tx_sent;
-  } else {
-    size = tx_index - tx_sent;
-  }
-  return std::pair<const char *, size_t>{&output_buffer[send_index], size};
+  return output.write_buffer();
 }
 
-auto App::write_done(size_t length) -> void {
-  size_t new_sent = tx_sent + length;
-  if (new_sent >= sizeof(output_buffer)) {
-    new_sent = 0;
-  }
-  tx_sent = new_sent;
-}
+auto App::write_done(size_t length) -> void { output.write_done(length); }
@@ -1,18 +1,43 @@
 #include "io/console.h"
 
 #include <cstdarg>
+#include <cstring>
 
-Console::Console(const char *banner, const Command *commands)
+Console::Console(const char *banner, Commands commands)
     : banner_{banner},
       commands_{commands},
-      parse_state_{ParseState::CHARACTER},
-      tx_index_{0},
-      tx_sent_{0} {
-  const char *scan = banner;
-  while (*scan != '\0') output_buffer_[tx_index_++] = *scan++;
+      parse_state_{ParseState::CHARACTER} {
+  output_.write(banner, strlen(banner));
   edit_.reset();
 }
 
+auto Console::Parameter::to_unsigned(uint32_t &value, unsigned base) const
+    -> bool {
+  auto scan = token;
+  auto end = token + size;
+  return Conversion::to_unsigned(scan, end, value, base) ==
+             Conversion::Status::OK &&
+         scan == end;
+}
+
+auto Console::Parameter::to_signed(int32_t &value, unsigned base) const
+    -> bool {
+  auto scan = token;
+  auto end = token + size;
+  return Conversion::to_signed(scan, end, value, base) ==
+             Conversion::Status::OK &&
+         scan == end;
+}
+
+auto Console::Parameter::to_fixed(unsigned decimals, int32_t &value) const
+    -> bool {
+  auto scan = token;
+  auto end = token + size;
+  return Conversion::to_fixed(scan, end, decimals, value) ==
+             Conversion::Status::OK &&
+         scan == end;
+}
+
 auto Console::read_buffer() -> std::pair<uint8_t *, size_t> {
   return std::pair<uint8_t *, size_t>{rx_buffer_, sizeof(rx_buffer_)};
 }
@@ -27,41 +52,25 @@ auto Console::read_done(size_t length) -> void {
       tokenise();
       if (command_line_.number > 0) {
         auto command = find_command(command_line_.parameters[0]);
-        if (command && command->handler) command->handler(*this, command_line_);
+        if (command) command->handler(*this, command_line_);
       }
       edit_.reset();
       parse_state_ = ParseState::CHARACTER;
-      printf("GH> ");
+      write(PROMPT, sizeof(PROMPT) - 1);
     }
   }
 }
 
 auto Console::write_buffer() -> std::pair<const char *, size_t> {
-  size_t size = 0;
-  size_t send_index = tx_sent_;
-  // If buffer has been wrapped this is true.
-  if (tx_index_ < tx_sent_)
-    size = sizeof(output_buffer_) - tx_sent_;
-  else
-    size = tx_index_ - tx_sent_;
-  return std::pair<const char *, size_t>{&output_buffer_[send_index], size};
+  return output_.write_buffer();
 }
 
-auto Console::write_done(size_t length) -> void {
-  size_t new_sent = tx_sent_ + length;
-  if (new_sent >= sizeof(output_buffer_)) new_sent = 0;
-  tx_sent_ = new_sent;
-}
+auto Console::write_done(size_t length) -> void { output_.write_done(length); }
+
+auto Console::putc(char c) -> bool { return output_.putc(c); }
 
-auto Console::putc(char c) -> bool {
-  auto new_index = tx_index_ + 1;
-  // wrap the buffer.
-  if (new_index >= sizeof(output_buffer_)) new_index = 0;
-  // Check for buffer full.
-  if (new_index == tx_sent_) return false;
-  output_buffer_[tx_index_] = c;
-  tx_index_ = new_index;
-  return true;
+auto Console::write(const char *data, size_t length) -> size_t {
+  return output_.write(data, length);
 }
 
 auto Console::printf(FORMAT format...) -> int {
@@ -73,70 +82,7 @@ auto Console::printf(FORMAT format...) -> int {
 }
 
 auto Console::vprintf(FORMAT format, va_list args) -> int {
-  int result;
-  bool room = true;
-  while (room && *format != '\0') {
-    if (*format == '%') {
-      ++format;
-      auto type = conversion_.parse(format);
-      if (type == Conversion::Type::UNKNOWN) break;
-      const char *buffer = nullptr;
-      switch (type) {
-        case Conversion::Type::PERCENT: {
-          buffer = conversion_.from_character('%');
-        } break;
-        case Conversion::Type::CHARACTER: {
-          auto value = va_arg(args, int);
-          buffer = conversion_.from_character(value);
-        } break;
-        case Conversion::Type::SIGNED_INT: {
-          auto value = va_arg(args, int);
-          buffer = conversion_.from_signed_int(value);
-        } break;
-        case Conversion::Type::UNSIGNED_INT: {
-          auto value = va_arg(args, unsigned);
-          buffer = conversion_.from_unsigned_int(value);
-        } break;
-        case Conversion::Type::LONG_SIGNED_INT: {
-          auto value = va_arg(args, long);
-          buffer = conversion_.from_signed_int(value);
-        } break;
-        case Conversion::Type::LONG_UNSIGNED_INT: {
-          auto value = va_arg(args, unsigned long);
-          buffer = conversion_.from_unsigned_int(value);
-        } break;
-        case Conversion::Type::LONG_LONG_SIGNED_INT: {
-          auto value = va_arg(args, long long);
-          buffer = conversion_.from_signed_int(value);
-        } break;
-        case Conversion::Type::LONG_LONG_UNSIGNED_INT: {
-          auto value = va_arg(args, unsigned long long);
-          buffer = conversion_.from_unsigned_int(value);
-        } break;
-        case Conversion::Type::POINTER: {
-          auto value = (uint32_t)va_arg(args, void *);
-          buffer = conversion_.from_unsigned_int(value);
-        } break;
-        case Conversion::Type::DOUBLE: {
-          auto value = va_arg(args, double);
-          buffer = conversion_.from_double(value);
-        } break;
-        case Conversion::Type::STRING: {
-          auto value = va_arg(args, char *);
-          buffer = conversion_.from_string(value);
-        } break;
-        default:
-          break;
-      }
-      if (buffer) {
-        while (room && *buffer != '\0') room = putc(*buffer++);
-      }
-    } else {
-      room = putc(*format++);
-      ++result;
-    }
-  }
-  return result;
+  return output_.vprintf(format, args);
 }
 
 auto Console::edit(KeyAction action, char c) -> bool {
@@ -144,6 +90,8 @@ auto Console::edit(KeyAction action, char c) -> bool {
     case KeyAction::NONE:
       break;
     case KeyAction::PROCESS:
+      history_.add(edit_.buffer, edit_.end);
+      history_.position = 0;
       return true;
       break;
     case KeyAction::ADD:
@@ -154,10 +102,11 @@ auto Console::edit(KeyAction action, char c) -> bool {
         auto index = edit_.cursor;
         edit_.buffer[edit_.cursor++] = c;
         edit_.buffer[++edit_.end] = '\0';
-        while (index < edit_.end) putc(edit_.buffer[index++]);
-        while (index > edit_.cursor) {
-          putc('\b');
-          --index;
+        if (edit_.cursor == edit_.end) {
+          // Typing or pasting at the end, just the echo.
+          putc(c);
+        } else {
+          redraw(index, edit_.end);
         }
       }
       break;
@@ -168,15 +117,12 @@ auto Console::edit(KeyAction action, char c) -> bool {
         --edit_.cursor;
         --edit_.end;
         edit_.buffer[edit_.end] = '\0';
-        putc('\b');
-        auto index = edit_.cursor;
-        while (index < edit_.end) putc(edit_.buffer[index++]);
-        putc(' ');
-        while (index > edit_.cursor) {
-          putc('\b');
-          --index;
+        if (edit_.cursor == edit_.end) {
+          write("\b \b", 3);
+        } else {
+          move_cursor();
+          redraw(edit_.cursor, edit_.end + 1);
         }
-        putc('\b');
       }
       break;
     case KeyAction::DELETE:
@@ -185,44 +131,98 @@ auto Console::edit(KeyAction action, char c) -> bool {
           edit_.buffer[i] = edit_.buffer[i + 1];
         --edit_.end;
         edit_.buffer[edit_.end] = '\0';
-        auto index = edit_.cursor;
-        while (index < edit_.end) putc(edit_.buffer[index++]);
-        putc(' ');
-        while (index > edit_.cursor) {
-          putc('\b');
-          --index;
-        }
-        putc('\b');
+        redraw(edit_.cursor, edit_.end + 1);
       }
       break;
     case KeyAction::CURSOR_LEFT:
       if (edit_.cursor > 0) {
         --edit_.cursor;
-        printf("\e[D");
+        write("\e[D", 3);
       }
       break;
     case KeyAction::CURSOR_RIGHT:
       if (edit_.cursor < edit_.end) {
         ++edit_.cursor;
-        printf("\e[C");
+        write("\e[C", 3);
       }
       break;
     case KeyAction::CURSOR_HOME:
-      while (edit_.cursor > 0) {
-        --edit_.cursor;
-        printf("\e[D");
+      if (edit_.cursor > 0) {
+        edit_.cursor = 0;
+        move_cursor();
       }
       break;
     case KeyAction::CURSOR_END:
-      while (edit_.cursor < edit_.end) {
-        ++edit_.cursor;
-        printf("\e[C");
+      if (edit_.cursor < edit_.end) {
+        edit_.cursor = edit_.end;
+        move_cursor();
       }
       break;
+    case KeyAction::HISTORY_BACK:
+      if (history_.position < history_.count) recall(history_.position + 1);
+      break;
+    case KeyAction::HISTORY_FORWARD:
+      if (history_.position > 0) recall(history_.position - 1);
+      break;
   }
   return false;
 }
 
+// Replace the line with one from history, only redrawing from where they
+// differ.
+auto Console::recall(size_t position) -> void {
+  if (history_.position == 0) history_.pending = edit_;
+  history_.position = position;
+  const auto &line = history_.line(position);
+  size_t same = 0;
+  while (same < line.end && same < edit_.end &&
+         line.buffer[same] == edit_.buffer[same])
+    ++same;
+  auto old_end = edit_.end;
+  memcpy(edit_.buffer, line.buffer, line.end);
+  edit_.end = line.end;
+  edit_.buffer[edit_.end] = '\0';
+  if (edit_.cursor != same) {
+    edit_.cursor = same;
+    move_cursor();
+  }
+  edit_.cursor = edit_.end;
+  redraw(same, old_end);
+}
+
+// The line from the terminal's cursor, at from, on. Anything left of a longer
+// line up to old_end is cleared and the cursor put back.
+auto Console::redraw(size_t from, size_t old_end) -> void {
+  write(&edit_.buffer[from], edit_.end - from);
+  if (old_end > edit_.end) write("\e[K", 3);
+  if (edit_.cursor != edit_.end) move_cursor();
+}
+
+// To the cursor's column in one escape, the prompt is in front of the line.
+auto Console::move_cursor() -> void {
+  print<"\e[%uG">(
+      static_cast<unsigned>(sizeof(PROMPT) - 1 + edit_.cursor + 1));
+}
+
+auto Console::History::add(const char *line, size_t length) -> void {
+  if (length == 0) return;
+  if (count > 0) {
+    const auto &last = this->line(1);
+    if (last.end == length && memcmp(last.buffer, line, length) == 0) return;
+  }
+  auto &entry = lines[next];
+  memcpy(entry.buffer, line, length);
+  entry.end = length;
+  entry.cursor = length;
+  next = (next + 1) % SIZE;
+  if (count < SIZE) ++count;
+}
+
+auto Console::History::line(size_t position) const -> const EditBuffer & {
+  if (position == 0) return pending;
+  return lines[(next + SIZE - position) % SIZE];
+}
+
 auto Console::tokenise() -> void {
   command_line_.number = 0;
   size_t index = 0;
@@ -256,18 +256,31 @@ auto Console::tokenise() -> void {
   command_line_.number = number;
 }
 
+// Exact match, or the only command starting with first. Prefixes are
+// together in the sorted table so a binary search finds them all.
 auto Console::find_command(Parameter &first) -> const Command * {
-  auto scan = commands_;
-  while (scan && scan->name && scan->handler) {
-    bool found = true;
-    size_t index = 0;
-    while (found && index < first.size) {
-      if (first.token[index] != scan->name[index]) found = false;
-      ++index;
-    }
-    if (found) return scan;
-    ++scan;
+  if (first.size == 0) return nullptr;
+  auto token = std::string_view{first.token, first.size};
+  auto begin = commands_.commands;
+  auto end = begin + commands_.size;
+  auto before = [](const Command &command, std::string_view key) -> bool {
+    return std::string_view{command.name} < key;
+  };
+  auto match = std::lower_bound(begin, end, token, before);
+  auto starts = [&token](const Command *command) -> bool {
+    return std::string_view{command->name}.substr(0, token.size()) == token;
+  };
+  if (match == end || !starts(match)) {
+    printf("Unknown command\r\n");
+    return nullptr;
   }
+  if (std::string_view{match->name} == token) return match;
+  auto last = match + 1;
+  while (last != end && starts(last)) ++last;
+  if (last == match + 1) return match;
+  printf("Ambiguous:");
+  for (auto scan = match; scan != last; ++scan) printf(" %s", scan->name);
+  printf("\r\n");
   return nullptr;
 }
 
@@ -283,7 +296,8 @@ auto Console::parse_character(char c) -> KeyAction {
   if (c == '\t') c = ' ';
   if (c == '\e') {
     parse_state_ = ParseState::ESCAPED;
-  } else if (c == '\b') {
+  } else if (c == '\b' || c == 127) {
+    // Most terminals send DEL for backspace.
     result = KeyAction::BACKSPACE;
   } else if (c >= ' ' && c < 127) {
     result = KeyAction::ADD;
@@ -308,10 +322,10 @@ auto Console::parse_escape_sequence(char c) -> KeyAction {
         break;
       case ParseState::ESCAPED_SQBKT:
         if (c == 'A') {
-          printf(" <UP> ");
+          result = KeyAction::HISTORY_BACK;
           parse_state_ = ParseState::CHARACTER;
         } else if (c == 'B') {
-          printf(" <DOWN> ");
+          result = KeyAction::HISTORY_FORWARD;
           parse_state_ = ParseState::CHARACTER;
         } else if (c == 'C') {
           result = KeyAction::CURSOR_RIGHT;
@@ -364,8 +378,8 @@ auto Console::parse_escape_sequence(char c) -> KeyAction {
   return result;
 }
 
-char Console::output_buffer_[OUTPUT_BUFFER_SIZE];
+RingSink<Console::OUTPUT_BUFFER_SIZE> Console::output_;
 Console::EditBuffer Console::edit_;
+Console::History Console::history_;
 uint8_t Console::rx_buffer_[RX_BUFFER_SIZE];
-Conversion Console::conversion_;
 Console::CommandLine Console::command_line_;
@@ -1,195 +1,235 @@
 #include "io/conversion.h"
 
-// #include "app/hal/util.h"
+#include <array>
+#include <bit>
+#include <cstring>
 
-auto Conversion::to_signed_int(const char *start, unsigned base) -> int {
-  // hal_error_handler(__FILE__, __LINE__, "Implement me!");
-  return 0;
-}
+namespace {
 
-auto Conversion::to_unsigned_int(const char *start, unsigned base) -> unsigned {
-  // hal_error_handler(__FILE__, __LINE__, "Implement me!");
-  return 0;
-}
+using Status = Conversion::Status;
 
-auto Conversion::to_double(const char *start) -> double {
-  // hal_error_handler(__FILE__, __LINE__, "Implement me!");
-  return 0.0;
+// Exactly representable powers of ten.
+constexpr double POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                    1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                    1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                    1e18, 1e19, 1e20, 1e21, 1e22};
+constexpr int MAX_EXACT_POWER = 22;
+
+constexpr uint32_t POWERS_OF_TEN_32[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+auto detect_base(const char *&scan, const char *end, unsigned base)
+    -> unsigned {
+  if (base != 0) return base;
+  if (end - scan > 2 && scan[0] == '0') {
+    auto prefix = scan[1] | 0x20;
+    if (prefix == 'x') base = 16;
+    if (prefix == 'b') base = 2;
+    if (prefix == 'o') base = 8;
+    if (base != 0 && Conversion::digit(scan[2]) < base) {
+      scan += 2;
+      return base;
+    }
+  }
+  return 10;
 }
 
-auto Conversion::reset() -> void {
-  left_justified_ = false;
-  output_sign_ = false;
-  pad_positive_ = false;
-  alternate_ = false;
-  upper_case_ = false;
-  force_exponent_ = false;
-  dynamic_ = false;
-  precision_ = 1;
-  base_ = 0;
-  width_ = 1;
-  fill_ = ' ';
+auto negative_sign(const char *&scan, const char *end) -> bool {
+  if (scan < end && (*scan == '-' || *scan == '+')) return *scan++ == '-';
+  return false;
 }
 
-auto Conversion::parse(FORMAT &format) -> Type {
-  reset();
-  auto c = *format++;
-  if (c == '\0') return Type::UNKNOWN;
-  if (c == '-') {
-    left_justified_ = true;
-    c = *format++;
-  }
-  if (c == '\0') return Type::UNKNOWN;
-  if (c == '+') {
-    output_sign_ = true;
-    c = *format++;
-  }
-  if (c == '\0') return Type::UNKNOWN;
-  if (c == ' ') {
-    pad_positive_ = true;
-    c = *format++;
-  }
-  if (c == '\0') return Type::UNKNOWN;
-  if (c == '#') {
-    alternate_ = true;
-    c = *format++;
+// Digits in base, stops at the first non digit. Returns the number consumed,
+// or -1 on overflow.
+auto digits(const char *&scan, const char *end, uint32_t &value,
+            unsigned base) -> int {
+  int count = 0;
+  value = 0;
+  while (scan < end) {
+    auto d = Conversion::digit(*scan);
+    if (d >= base) break;
+    if (!Conversion::accumulate(value, d, base)) return -1;
+    ++scan;
+    ++count;
   }
-  if (c == '\0') return Type::UNKNOWN;
-  if (c == '0') {
-    fill_ = '0';
-    c = *format++;
-  }
-  if (c == '\0') return Type::UNKNOWN;
-  bool is_long = false;
-  if (c == 'l' || c == 'L') {
-    is_long = true;
-    c = *format++;
-  } else if (c == 'h' || c == 'j' || c == 'z' || c == 't') {
-    // ignore
-    c = *format++;
-  }
-  if (c == '\0') return Type::UNKNOWN;
-  bool is_long_long = false;
-  if (c == 'l') {
-    is_long = true;
-    c = *format++;
-  } else if (c == 'h') {
-    // ignore
-    c = *format++;
+  return count;
+}
+
+auto signed_result(bool negative, uint32_t magnitude, int32_t &value)
+    -> Status {
+  if (negative) {
+    if (magnitude > static_cast<uint32_t>(INT32_MAX) + 1) return Status::RANGE;
+    value = static_cast<int32_t>(0U - magnitude);
+  } else {
+    if (magnitude > INT32_MAX) return Status::RANGE;
+    value = static_cast<int32_t>(magnitude);
   }
-  if (c == '\0') return Type::UNKNOWN;
-  int width = -1;
-  if (c > '0' && c <= '9') {
-    width = 0;
-    while (c > '0' && c <= '9') {
-      width = (width * 10) + (c - '0');
-      c = *format++;
+  return Status::OK;
+}
+
+}  // namespace
+
+auto Conversion::to_unsigned(const char *&scan, const char *end,
+                             uint32_t &value, unsigned base) -> Status {
+  if (scan >= end) return Status::EMPTY;
+  base = detect_base(scan, end, base);
+  auto count = digits(scan, end, value, base);
+  if (count < 0) return Status::RANGE;
+  return (count == 0) ? Status::INVALID : Status::OK;
+}
+
+auto Conversion::to_signed(const char *&scan, const char *end, int32_t &value,
+                           unsigned base) -> Status {
+  if (scan >= end) return Status::EMPTY;
+  auto negative = negative_sign(scan, end);
+  uint32_t magnitude;
+  auto status = to_unsigned(scan, end, magnitude, base);
+  if (status != Status::OK) return (status == Status::EMPTY) ? Status::INVALID
+                                                              : status;
+  return signed_result(negative, magnitude, value);
+}
+
+auto Conversion::to_fixed(const char *&scan, const char *end,
+                          unsigned decimals, int32_t &value) -> Status {
+  if (scan >= end) return Status::EMPTY;
+  if (decimals >= sizeof(POWERS_OF_TEN_32) / sizeof(POWERS_OF_TEN_32[0]))
+    return Status::RANGE;
+  auto negative = negative_sign(scan, end);
+  uint32_t magnitude;
+  auto count = digits(scan, end, magnitude, 10);
+  if (count < 0) return Status::RANGE;
+  // Scale the whole part, then add the fraction digit by digit.
+  auto scaled = static_cast<uint64_t>(magnitude) * POWERS_OF_TEN_32[decimals];
+  if (scaled > UINT32_MAX) return Status::RANGE;
+  magnitude = static_cast<uint32_t>(scaled);
+  if (scan < end && *scan == '.') {
+    ++scan;
+    uint32_t fraction = 0;
+    unsigned places = 0;
+    bool round_up = false;
+    while (scan < end) {
+      auto d = digit(*scan);
+      if (d >= 10) break;
+      if (places < decimals) {
+        fraction = (fraction * 10) + d;
+        ++places;
+      } else if (places == decimals) {
+        // First dropped digit decides the rounding.
+        round_up = d >= 5;
+        ++places;
+      }
+      ++scan;
+      ++count;
     }
+    if (places < decimals)
+      fraction *= POWERS_OF_TEN_32[decimals - places];
+    if (round_up) ++fraction;
+    auto total = static_cast<uint64_t>(magnitude) + fraction;
+    if (total > UINT32_MAX) return Status::RANGE;
+    magnitude = static_cast<uint32_t>(total);
   }
-  if (c == '\0') return Type::UNKNOWN;
-  int precision = -1;
-  if (c == '.') {
-    precision = 0;
-    c = *format;
-    while (c > '0' && c <= '9') {
-      precision = (precision * 10) + (c - '0');
-      c = *format++;
+  if (count == 0) return Status::INVALID;
+  return signed_result(negative, magnitude, value);
+}
+
+auto Conversion::to_double(const char *&scan, const char *end, double &value)
+    -> Status {
+  if (scan >= end) return Status::EMPTY;
+  auto negative = negative_sign(scan, end);
+  // Up to 19 significant digits in an integer, the rest just scale.
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  int count = 0;
+  int significant = 0;
+  bool fraction = false;
+  while (scan < end) {
+    auto c = *scan;
+    if (c == '.' && !fraction) {
+      fraction = true;
+    } else {
+      auto d = digit(c);
+      if (d >= 10) break;
+      if (significant < 19) {
+        mantissa = (mantissa * 10) + d;
+        if (mantissa != 0) ++significant;
+        if (fraction) --exponent;
+      } else if (!fraction) {
+        ++exponent;
+      }
+      ++count;
     }
+    ++scan;
   }
-  bool is_unsigned = true;
-  if (c == '\0') return Type::UNKNOWN;
-  if (c == '%')
-    return Type::PERCENT;
-  else if (c == 'c')
-    return Type::CHARACTER;
-  else if (c == 's') {
-    if (width > 0)
-      width_ = width;
-    else
-      width_ = 0;
-    if (precision > 0)
-      precision_ = precision;
-    else
-      precision_ = 0;
-    return Type::STRING;
-    // Integer conversions
-  } else if (c == 'p') {
-    reset();
-    base_ = 16;
-    width_ = 8;
-    upper_case_ = true;
-    return Type::POINTER;
-  } else if (c == 'd' || c == 'i') {
-    is_unsigned = false;
-    base_ = 10;
-  } else if (c == 'o')
-    base_ = 8;
-  else if (c == 'b')
-    base_ = 2;
-  else if (c == 'X') {
-    upper_case_ = true;
-    base_ = 16;
-  } else if (c == 'x')
-    base_ = 16;
-  if (base_ != 0) {
-    if (width < 0)
-      width_ = 1;
-    else
-      width_ = width;
-    if (precision < 0)
-      precision_ = 1;
-    else
-      precision_ = precision;
-    if (is_unsigned) {
-      if (is_long_long) return Type::LONG_LONG_UNSIGNED_INT;
-      if (is_long) return Type::LONG_UNSIGNED_INT;
-      return Type::UNSIGNED_INT;
+  if (count == 0) return Status::INVALID;
+  if (scan < end && (*scan | 0x20) == 'e') {
+    auto mark = scan++;
+    int32_t power;
+    if (to_signed(scan, end, power, 10) == Status::OK) {
+      if (power > 400) power = 400;
+      if (power < -400) power = -400;
+      exponent += power;
     } else {
-      if (is_long_long) return Type::LONG_LONG_SIGNED_INT;
-      if (is_long) return Type::LONG_SIGNED_INT;
-      return Type::SIGNED_INT;
+      // Not an exponent after all.
+      scan = mark;
     }
   }
-  // Floating point conversions.
-  base_ = 10;
-  if (width < 0)
-    width_ = 1;
-  else
-    width_ = width;
-  if (precision < 0)
-    precision_ = 6;
-  else
-    precision_ = precision;
-  if (c == 'f')
-    return Type::DOUBLE;
-  else if (c == 'F') {
-    upper_case_ = true;
-    return Type::DOUBLE;
-  } else if (c == 'e') {
-    force_exponent_ = true;
-    return Type::DOUBLE;
-  } else if (c == 'E') {
-    force_exponent_ = true;
-    upper_case_ = true;
-    return Type::DOUBLE;
-  } else if (c == 'a') {
-    base_ = 16;
-    force_exponent_ = true;
-    return Type::DOUBLE;
-  } else if (c == 'A') {
-    base_ = 16;
-    force_exponent_ = true;
-    upper_case_ = true;
-    return Type::DOUBLE;
-  } else if (c == 'g') {
-    dynamic_ = true;
-    return Type::DOUBLE;
-  } else if (c == 'G') {
-    dynamic_ = true;
-    upper_case_ = true;
-    return Type::DOUBLE;
+  double result = static_cast<double>(mantissa);
+  while (exponent > MAX_EXACT_POWER) {
+    result *= POWERS_OF_TEN[MAX_EXACT_POWER];
+    exponent -= MAX_EXACT_POWER;
+  }
+  while (exponent < -MAX_EXACT_POWER) {
+    result /= POWERS_OF_TEN[MAX_EXACT_POWER];
+    exponent += MAX_EXACT_POWER;
   }
-  return Type::UNKNOWN;
+  if (exponent > 0) result *= POWERS_OF_TEN[exponent];
+  if (exponent < 0) result /= POWERS_OF_TEN[-exponent];
+  value = negative ? -result : result;
+  return Status::OK;
+}
+
+auto Conversion::to_signed_int(const char *start, unsigned base) -> int {
+  int32_t value = 0;
+  auto end = start + strlen(start);
+  if (to_signed(start, end, value, base) != Status::OK) return 0;
+  return value;
+}
+
+auto Conversion::to_unsigned_int(const char *start, unsigned base) -> unsigned {
+  uint32_t value = 0;
+  auto end = start + strlen(start);
+  if (to_unsigned(start, end, value, base) != Status::OK) return 0;
+  return value;
+}
+
+auto Conversion::to_double(const char *start) -> double {
+  double value = 0.0;
+  auto end = start + strlen(start);
+  if (to_double(start, end, value) != Status::OK) return 0.0;
+  return value;
+}
+
+auto Conversion::reset() -> void { apply(Spec{}); }
+
+auto Conversion::apply(const Spec &spec) -> void {
+  left_justified_ = spec.left_justified;
+  output_sign_ = spec.output_sign;
+  pad_positive_ = spec.pad_positive;
+  alternate_ = spec.alternate;
+  upper_case_ = spec.upper_case;
+  force_exponent_ = spec.force_exponent;
+  dynamic_ = spec.dynamic;
+  precision_ = spec.precision;
+  base_ = spec.base;
+  width_ = spec.width;
+  fill_ = spec.fill;
+}
+
+auto Conversion::parse(FORMAT &format) -> Type {
+  Spec spec;
+  auto type = parse(format, spec);
+  apply(spec);
+  return type;
 }
 
 auto Conversion::from_character(long long value) -> const char * {
@@ -199,7 +239,8 @@ auto Conversion::from_character(long long value) -> const char * {
 }
 
 auto Conversion::from_signed_int(long long value) -> const char * {
-  if (value < 0) return from_int_(true, -value);
+  if (value < 0)
+    return from_int_(true, 0ULL - static_cast<unsigned long long>(value));
   return from_int_(false, value);
 }
 
@@ -207,9 +248,350 @@ auto Conversion::from_unsigned_int(unsigned long long value) -> const char * {
   return from_int_(false, value);
 }
 
+namespace {
+
+// Floating point formatting using only integer arithmetic. A value is held as
+// a normalised 64 bit significand m and binary exponent e, x = m * 2^e.
+// Values below 2^64 with no bits below 2^-60 split exactly into a 64 bit
+// integer and a 60 bit binary fraction, so every digit and the rounding are
+// exact. Anything else is scaled into [1, 10) by multiplying by normalised
+// powers of ten, good for MAX_SIGNIFICANT digits.
+
+constexpr int MAX_SIGNIFICANT = 17;
+constexpr int FIXED_BITS = 60;
+constexpr uint64_t FIXED_ONE = 1ULL << FIXED_BITS;
+constexpr uint64_t FIXED_MASK = FIXED_ONE - 1;
+constexpr uint64_t FIXED_HALF = 5 * FIXED_ONE;  // Half of a digit times ten.
+
+// 10, 0.1, 1e8 and 1e-8 as normalised significands.
+constexpr uint64_t TEN = 0xa000000000000000ULL;      // 10 * 2^60
+constexpr uint64_t TENTH = 0xcccccccccccccccdULL;    // 0.1 * 2^67
+constexpr uint64_t TEN_8 = 0xbebc200000000000ULL;    // 1e8 * 2^37
+constexpr uint64_t TENTH_8 = 0xabcc77118461cefdULL;  // 1e-8 * 2^90
+
+// High 64 bits of a 64 x 64 bit product, from 32 bit multiplies.
+auto mul_high(uint64_t a, uint64_t b) -> uint64_t {
+  auto a_lo = static_cast<uint32_t>(a);
+  auto a_hi = static_cast<uint32_t>(a >> 32);
+  auto b_lo = static_cast<uint32_t>(b);
+  auto b_hi = static_cast<uint32_t>(b >> 32);
+  auto lo_lo = static_cast<uint64_t>(a_lo) * b_lo;
+  auto hi_lo = static_cast<uint64_t>(a_hi) * b_lo;
+  auto lo_hi = static_cast<uint64_t>(a_lo) * b_hi;
+  auto hi_hi = static_cast<uint64_t>(a_hi) * b_hi;
+  auto middle = (lo_lo >> 32) + static_cast<uint32_t>(hi_lo) +
+                static_cast<uint32_t>(lo_hi);
+  return hi_hi + (hi_lo >> 32) + (lo_hi >> 32) + (middle >> 32);
+}
+
+struct Binary {
+  uint64_t m;
+  int e;
+  auto normalise() -> void {
+    while ((m >> 63) == 0) {
+      m <<= 1;
+      --e;
+    }
+  }
+  auto multiply(uint64_t factor, int shift) -> void {
+    m = mul_high(m, factor);
+    e += shift;
+    normalise();
+  }
+};
+
+// Stream of decimal digits, most significant first. The next digit is the
+// top four bits of rest, which holds the remainder times ten.
+struct Decimal {
+  char integer[20];
+  int integer_length = 0;
+  int next = 0;
+  uint64_t rest = 0;
+  bool exact = true;
+  int exponent = 0;  // Of the first digit.
+
+  auto digit() -> char {
+    if (next < integer_length) return integer[next++];
+    ++next;
+    auto digit = static_cast<char>('0' + (rest >> FIXED_BITS));
+    rest = (rest & FIXED_MASK) * 10;
+    return digit;
+  }
+
+  // Whether what follows the digits taken so far rounds up. Exact halves go
+  // to even like printf, approximate ones allow a little for the truncation
+  // in scaling so 0.5 that came out as 0.4999... still rounds up.
+  auto round_up(char last) -> bool {
+    if (!exact) {
+      uint64_t slack = 4;
+      for (int i = 0; i < next && i < 15; ++i) slack *= 10;
+      return rest + slack >= FIXED_HALF;
+    }
+    int half;
+    if (next < integer_length) {
+      half = integer[next] - '5';
+      for (auto i = next + 1; half == 0 && i < integer_length; ++i)
+        if (integer[i] != '0') half = 1;
+      if (half == 0 && rest != 0) half = 1;
+    } else {
+      half = (rest > FIXED_HALF) ? 1 : (rest == FIXED_HALF) ? 0 : -1;
+    }
+    return half > 0 || (half == 0 && ((last - '0') & 1));
+  }
+};
+
+auto decimal(Binary x) -> Decimal {
+  Decimal decimal;
+  if (x.e <= 0 && x.e >= -FIXED_BITS - 11) {
+    // Lowest significand bit is at or above 2^-60, doubles only fill the top
+    // 53 bits of m.
+    auto whole = (x.e <= -64) ? 0 : x.m >> -x.e;
+    auto shift = -x.e - FIXED_BITS;
+    auto fraction =
+        ((shift >= 0) ? x.m >> shift : x.m << -shift) & FIXED_MASK;
+    char reversed[20];
+    while (whole != 0) {
+      reversed[decimal.integer_length++] =
+          static_cast<char>('0' + (whole % 10));
+      whole /= 10;
+    }
+    for (auto i = 0; i < decimal.integer_length; ++i)
+      decimal.integer[i] = reversed[decimal.integer_length - 1 - i];
+    decimal.rest = fraction * 10;
+    if (decimal.integer_length != 0) {
+      decimal.exponent = decimal.integer_length - 1;
+    } else {
+      decimal.exponent = -1;
+      while ((decimal.rest >> FIXED_BITS) == 0) {
+        decimal.rest *= 10;
+        --decimal.exponent;
+      }
+    }
+    return decimal;
+  }
+  decimal.exact = false;
+  for (;;) {
+    if (x.e >= -36) {
+      // x >= 2^27
+      x.multiply(TENTH_8, -26);
+      decimal.exponent += 8;
+    } else if (x.e > -60 || (x.e == -60 && (x.m >> 60) >= 10)) {
+      x.multiply(TENTH, -3);
+      decimal.exponent += 1;
+    } else if (x.e <= -91) {
+      // x < 2^-27
+      x.multiply(TEN_8, 27);
+      decimal.exponent -= 8;
+    } else if (x.e <= -64) {
+      x.multiply(TEN, 4);
+      decimal.exponent -= 1;
+    } else {
+      break;
+    }
+  }
+  decimal.rest = x.m >> (-x.e - FIXED_BITS);
+  return decimal;
+}
+
+// Take count (>= 0) rounded digits into digits. Returns 1 if rounding carried
+// into a new leading digit, which becomes digits[0] with the rest zero.
+auto round_digits(Decimal decimal, int count, char *digits) -> int {
+  auto significant = decimal.exact ? count
+                     : (count < MAX_SIGNIFICANT) ? count
+                                                 : MAX_SIGNIFICANT;
+  for (auto i = 0; i < significant; ++i) digits[i] = decimal.digit();
+  for (auto i = significant; i < count; ++i) digits[i] = '0';
+  auto last = (significant > 0) ? digits[significant - 1] : '0';
+  if (!decimal.round_up(last)) return 0;
+  for (auto i = significant - 1; i >= 0; --i) {
+    if (digits[i] != '9') {
+      ++digits[i];
+      return 0;
+    }
+    digits[i] = '0';
+  }
+  if (count > 0) digits[0] = '1';
+  return 1;
+}
+
+auto put_exponent(char *out, int exponent, char marker) -> size_t {
+  size_t index = 0;
+  out[index++] = marker;
+  out[index++] = (exponent < 0) ? '-' : '+';
+  unsigned magnitude = (exponent < 0) ? -exponent : exponent;
+  char reversed[4];
+  size_t count = 0;
+  do {
+    reversed[count++] = static_cast<char>('0' + (magnitude % 10));
+    magnitude /= 10;
+  } while (magnitude != 0);
+  if (marker != 'p' && marker != 'P' && count < 2) reversed[count++] = '0';
+  while (count) out[index++] = reversed[--count];
+  return index;
+}
+
+}  // namespace
+
 auto Conversion::from_double(double value) -> const char * {
-  // hal_error_handler(__FILE__, __LINE__, "Implement me!");
-  return nullptr;
+  uint64_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  bool negative = (bits >> 63) != 0;
+  auto biased = static_cast<int>((bits >> 52) & 0x7ff);
+  auto fraction = bits & ((1ULL << 52) - 1);
+
+  // Body without sign or padding.
+  char body[CONVERSION_BUFFER_SIZE];
+  size_t length = 0;
+  if (biased == 0x7ff) {
+    const char *text = (fraction != 0) ? (upper_case_ ? "NAN" : "nan")
+                                       : (upper_case_ ? "INF" : "inf");
+    memcpy(body, text, 3);
+    length = 3;
+    if (fraction != 0) negative = false;
+    return finish_double_(negative, body, length, false);
+  }
+
+  Binary x{0, 0};
+  bool zero = biased == 0 && fraction == 0;
+  if (!zero) {
+    // Subnormals have no implicit bit and a fixed exponent.
+    x.m = (biased == 0) ? fraction : fraction | (1ULL << 52);
+    x.e = ((biased == 0) ? 1 : biased) - 1075;
+    x.normalise();
+  }
+
+  if (base_ == 16) {
+    // Hex float, 0x1.hhhp+d with precision_ hex digits.
+    body[length++] = '0';
+    body[length++] = upper_case_ ? 'X' : 'x';
+    int exponent = 0;
+    uint64_t m = 0;
+    if (!zero) {
+      // 1.xxx with 60 fraction bits.
+      m = x.m >> 3;
+      exponent = x.e + 63;
+      if (precision_ < 15) {
+        auto drop = 60 - (4 * precision_);
+        auto half = 1ULL << (drop - 1);
+        m = (m + half) & ~((half << 1) - 1);
+        if ((m >> 61) != 0) {
+          m >>= 1;
+          ++exponent;
+        }
+      }
+    }
+    body[length++] = zero ? '0' : '1';
+    body[length++] = '.';
+    auto digits = upper_case_ ? "0123456789ABCDEF" : "0123456789abcdef";
+    for (unsigned i = 0; i < precision_; ++i) {
+      body[length++] = digits[(m >> (56 - (4 * i))) & 0x0f];
+    }
+    if (dynamic_)
+      while (body[length - 1] == '0') --length;
+    if (body[length - 1] == '.' && !alternate_) --length;
+    length += put_exponent(&body[length], exponent, upper_case_ ? 'P' : 'p');
+    return finish_double_(negative, body, length, true);
+  }
+
+  Decimal source;
+  if (!zero) source = decimal(x);
+  int exponent = source.exponent;
+  char digits[CONVERSION_BUFFER_SIZE];
+  int precision = precision_;
+  int count = 0;
+  bool strip = false;
+  bool use_exponent = force_exponent_;
+  bool rounded = false;
+
+  if (dynamic_) {
+    // %g, precision is significant digits, choose the shorter form.
+    if (precision == 0) precision = 1;
+    count = precision;
+    if (zero)
+      memset(digits, '0', count);
+    else
+      exponent += round_digits(source, count, digits);
+    rounded = true;
+    use_exponent = exponent < -4 || exponent >= precision;
+    precision = use_exponent ? precision - 1 : precision - 1 - exponent;
+    strip = !alternate_;
+  }
+  // Fixed notation that can't fit in the buffer falls back to exponent form.
+  if (!use_exponent && exponent > static_cast<int>(sizeof(body)) - 24)
+    use_exponent = true;
+
+  if (use_exponent) {
+    if (!rounded) {
+      count = precision + 1;
+      if (zero)
+        memset(digits, '0', count);
+      else
+        exponent += round_digits(source, count, digits);
+    }
+    body[length++] = digits[0];
+    if (count > 1 || alternate_) body[length++] = '.';
+    for (int i = 1; i < count; ++i) body[length++] = digits[i];
+    if (strip) {
+      while (body[length - 1] == '0') --length;
+      if (body[length - 1] == '.' && !alternate_) --length;
+    }
+    length += put_exponent(&body[length], exponent, upper_case_ ? 'E' : 'e');
+  } else {
+    if (!rounded) {
+      // Significant digits up to the last place after the point.
+      count = exponent + 1 + precision;
+      if (zero || count < 0) {
+        count = 0;
+      } else if (round_digits(source, count, digits)) {
+        // 9.99 -> 10.0 or 0.9 -> 1, one more digit before the point.
+        ++exponent;
+        count = (count > 0) ? count + 1 : 1;
+        digits[count - 1] = '0';
+        digits[0] = '1';
+      }
+    }
+    // Digit at power of ten p, zero outside the significant digits.
+    auto digit_at = [&](int p) {
+      auto index = exponent - p;
+      return (index >= 0 && index < count) ? digits[index] : '0';
+    };
+    for (int p = (exponent > 0 && count > 0) ? exponent : 0; p >= 0; --p)
+      body[length++] = digit_at(p);
+    if (precision > 0 || alternate_) body[length++] = '.';
+    for (int p = -1; p >= -precision; --p) body[length++] = digit_at(p);
+    if (strip && precision > 0) {
+      while (body[length - 1] == '0') --length;
+      if (body[length - 1] == '.' && !alternate_) --length;
+    }
+  }
+  return finish_double_(negative, body, length, true);
+}
+
+auto Conversion::finish_double_(bool negative, const char *body, size_t length,
+                                bool finite) -> const char * {
+  char sign = '\0';
+  if (negative)
+    sign = '-';
+  else if (output_sign_)
+    sign = '+';
+  else if (pad_positive_)
+    sign = ' ';
+  size_t total = length + ((sign != '\0') ? 1 : 0);
+  size_t pad = (total < width_) ? width_ - total : 0;
+  if (total + pad >= sizeof(buffer_)) pad = 0;
+  size_t index = 0;
+  bool zeros = fill_ == '0' && !left_justified_ && finite;
+  if (!left_justified_ && !zeros)
+    while (pad) buffer_[index++] = ' ', --pad;
+  if (sign != '\0') buffer_[index++] = sign;
+  if (zeros)
+    while (pad) buffer_[index++] = '0', --pad;
+  if (length > sizeof(buffer_) - 1 - index) length = sizeof(buffer_) - 1 - index;
+  memcpy(&buffer_[index], body, length);
+  index += length;
+  while (pad) buffer_[index++] = ' ', --pad;
+  buffer_[index] = '\0';
+  return buffer_;
 }
 
 auto Conversion::from_string(const char *str) -> const char * {
@@ -231,68 +613,108 @@ auto Conversion::from_string(const char *str) -> const char * {
 
 auto Conversion::from_int_(bool negative, unsigned long long value) -> const
     char * {
-  size_t index = 0;
-  if (value == 0 && precision_ == 0) {
-    buffer_[index] = '\0';
-    return buffer_;
-  }
-  // Output the coversion backwards will sort out later.
-  if (upper_case_)
-    index = convert_upper_(index, value, base_);
-  else
-    index = convert_lower_(index, value, base_);
-  while (index < precision_) buffer_[index++] = '0';
+  // Written right to left ending at the end of the buffer so there is nothing
+  // to reverse, only a left justified result is moved.
+  auto end = &buffer_[sizeof(buffer_) - 1];
+  *end = '\0';
+  if (value == 0 && precision_ == 0) return end;
+  auto start = convert_(end, value, base_, upper_case_);
+  while (end - start < precision_) *--start = '0';
   if (negative)
-    buffer_[index++] = '-';
+    *--start = '-';
   else if (pad_positive_)
-    buffer_[index++] = fill_;
-  if (left_justified_) {
-    // Reverse it.
-    auto flip = 0U;
-    auto flop = index - 1;
-    while (flip < flop) {
-      auto tmp = buffer_[flip];
-      buffer_[flip++] = buffer_[flop];
-      buffer_[flop--] = tmp;
-    }
-    while (index < width_) buffer_[index++] = fill_;
-  } else {
-    while (index < width_) buffer_[index++] = fill_;
-    // Reverse it.
-    auto flip = 0U;
-    auto flop = index - 1;
-    while (flip < flop) {
-      auto tmp = buffer_[flip];
-      buffer_[flip++] = buffer_[flop];
-      buffer_[flop--] = tmp;
-    }
+    *--start = fill_;
+  auto length = static_cast<size_t>(end - start);
+  if (length >= width_) return start;
+  if (!left_justified_) {
+    while (length++ < width_) *--start = fill_;
+    return start;
   }
-  buffer_[index] = '\0';
+  memmove(buffer_, start, length);
+  while (length < width_) buffer_[length++] = fill_;
+  buffer_[length] = '\0';
   return buffer_;
 }
 
-auto Conversion::convert_lower_(size_t index, unsigned long long value,
-                                unsigned base) -> int {
-  while (value != 0) {
-    auto c = value % base;
-    value = value / base;
-    if (c > 9)
-      buffer_[index++] = c + ('a' - 10);
-    else
-      buffer_[index++] = c + '0';
+namespace {
+
+constexpr char LOWER_DIGITS[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+constexpr char UPPER_DIGITS[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+// "00" to "99", two digits for each divide.
+constexpr auto DIGIT_PAIRS = [] {
+  std::array<char, 200> pairs{};
+  for (int i = 0; i < 100; ++i) {
+    pairs[i * 2] = static_cast<char>('0' + (i / 10));
+    pairs[(i * 2) + 1] = static_cast<char>('0' + (i % 10));
   }
-  return index;
+  return pairs;
+}();
+
+// Decimal digits of a 32 bit value ending at end. The divides are 32 bit, on
+// the RP2040 the SDK runs those on the SIO hardware divider and the quotient
+// and remainder come from one divide.
+auto decimal(char *end, uint32_t value, int min_digits) -> char * {
+  auto start = end;
+  while (value >= 100) {
+    auto pair = value % 100;
+    value /= 100;
+    start -= 2;
+    memcpy(start, &DIGIT_PAIRS[pair * 2], 2);
+  }
+  if (value >= 10) {
+    start -= 2;
+    memcpy(start, &DIGIT_PAIRS[value * 2], 2);
+  } else if (value != 0 || start == end) {
+    *--start = static_cast<char>('0' + value);
+  }
+  while (end - start < min_digits) *--start = '0';
+  return start;
 }
 
-auto Conversion::convert_upper_(size_t index, unsigned long long value,
-                                unsigned base) -> int {
-  while (value != 0) {
-    auto c = value % base;
-    value = value / base;
-    if (c > 9)
-      buffer_[index++] = c + ('A' - 10);
-    else
-      buffer_[index++] = c + '0';
+}  // namespace
+
+auto Conversion::convert_(char *end, unsigned long long value, unsigned base,
+                          bool upper_case) -> char * {
+  auto digits = upper_case ? UPPER_DIGITS : LOWER_DIGITS;
+  auto start = end;
+  if (base == 10) {
+    // One 64 bit divide for every nine digits, the rest in 32 bits.
+    constexpr uint32_t BILLION = 1000 * 1000 * 1000;
+    while (value > UINT32_MAX) {
+      auto high = value / BILLION;
+      auto low = static_cast<uint32_t>(value - (high * BILLION));
+      start = decimal(start, low, 9);
+      value = high;
+    }
+    if (value != 0 || start == end)
+      start = decimal(start, static_cast<uint32_t>(value), 0);
+    return start;
   }
-  return index;
+  if ((base & (base - 1)) == 0) {
+    // Shifts for the powers of two.
+    auto shift = static_cast<unsigned>(std::countr_zero(base));
+    auto mask = base - 1;
+    while (value > UINT32_MAX) {
+      *--start = digits[value & mask];
+      value >>= shift;
+    }
+    auto low = static_cast<uint32_t>(value);
+    while (low != 0) {
+      *--start = digits[low & mask];
+      low >>= shift;
+    }
+    if (start == end) *--start = '0';
+    return start;
+  }
+  while (value > UINT32_MAX) {
+    *--start = digits[value % base];
+    value /= base;
+  }
+  auto low = static_cast<uint32_t>(value);
+  do {
+    *--start = digits[low % base];
+    low /= base;
+  } while (low != 0);
+  return start;
 }
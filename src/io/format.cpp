@@ -0,0 +1,78 @@
+#include "io/format.h"
+
+Conversion Format::conversion_;
+
+auto Format::vwrite(const Writer &writer, FORMAT format, va_list args) -> int {
+  int result = 0;
+  bool room = true;
+  while (room && *format != '\0') {
+    if (*format == '%') {
+      ++format;
+      auto type = conversion_.parse(format);
+      if (type == Conversion::Type::UNKNOWN) break;
+      const char *buffer = nullptr;
+      switch (type) {
+        case Conversion::Type::PERCENT: {
+          buffer = conversion_.from_character('%');
+        } break;
+        case Conversion::Type::CHARACTER: {
+          auto value = va_arg(args, int);
+          buffer = conversion_.from_character(value);
+        } break;
+        case Conversion::Type::SIGNED_INT: {
+          auto value = va_arg(args, int);
+          buffer = conversion_.from_signed_int(value);
+        } break;
+        case Conversion::Type::UNSIGNED_INT: {
+          auto value = va_arg(args, unsigned);
+          buffer = conversion_.from_unsigned_int(value);
+        } break;
+        case Conversion::Type::LONG_SIGNED_INT: {
+          auto value = va_arg(args, long);
+          buffer = conversion_.from_signed_int(value);
+        } break;
+        case Conversion::Type::LONG_UNSIGNED_INT: {
+          auto value = va_arg(args, unsigned long);
+          buffer = conversion_.from_unsigned_int(value);
+        } break;
+        case Conversion::Type::LONG_LONG_SIGNED_INT: {
+          auto value = va_arg(args, long long);
+          buffer = conversion_.from_signed_int(value);
+        } break;
+        case Conversion::Type::LONG_LONG_UNSIGNED_INT: {
+          auto value = va_arg(args, unsigned long long);
+          buffer = conversion_.from_unsigned_int(value);
+        } break;
+        case Conversion::Type::POINTER: {
+          auto value = reinterpret_cast<uintptr_t>(va_arg(args, void *));
+          buffer = conversion_.from_unsigned_int(value);
+        } break;
+        case Conversion::Type::DOUBLE: {
+          auto value = va_arg(args, double);
+          buffer = conversion_.from_double(value);
+        } break;
+        case Conversion::Type::STRING: {
+          auto value = va_arg(args, char *);
+          buffer = conversion_.from_string(value);
+        } break;
+        default:
+          break;
+      }
+      if (buffer) {
+        auto length = strlen(buffer);
+        auto written = writer.write(writer.context, buffer, length);
+        room = written == length;
+        result += written;
+      }
+    } else {
+      // Copy the literal run up to the next conversion as one block.
+      auto start = format;
+      while (*format != '\0' && *format != '%') ++format;
+      auto length = static_cast<size_t>(format - start);
+      auto written = writer.write(writer.context, start, length);
+      room = written == length;
+      result += written;
+    }
+  }
+  return result;
+}
@@ -0,0 +1,90 @@
+#include "io/frame.h"
+
+#include <cstring>
+
+namespace {
+
+// Nibble table, small enough to keep in flash and still only two lookups per
+// byte.
+constexpr uint16_t CRC_TABLE[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+    0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef};
+
+constexpr uint16_t CRC_INIT = 0xffff;
+
+auto crc_update(uint16_t crc, uint8_t c) -> uint16_t {
+  crc = (crc << 4) ^ CRC_TABLE[(crc >> 12) ^ (c >> 4)];
+  crc = (crc << 4) ^ CRC_TABLE[(crc >> 12) ^ (c & 0x0f)];
+  return crc;
+}
+
+}  // namespace
+
+auto Frame::crc16(uint16_t crc, const uint8_t *data, size_t length)
+    -> uint16_t {
+  while (length--) crc = crc_update(crc, *data++);
+  return crc;
+}
+
+auto Frame::encode(uint8_t type, const void *payload, size_t length,
+                   uint8_t *out) -> size_t {
+  out[0] = SYNC;
+  out[1] = static_cast<uint8_t>(length);
+  out[2] = type;
+  memcpy(&out[3], payload, length);
+  auto crc = crc16(CRC_INIT, &out[1], length + 2);
+  out[length + 3] = static_cast<uint8_t>(crc);
+  out[length + 4] = static_cast<uint8_t>(crc >> 8);
+  return length + OVERHEAD;
+}
+
+auto Frame::reset() -> void {
+  state_ = State::SYNC;
+  type_ = 0;
+  length_ = 0;
+  index_ = 0;
+  crc_ = CRC_INIT;
+}
+
+auto Frame::parse(uint8_t c) -> bool {
+  switch (state_) {
+    case State::SYNC:
+      if (c == SYNC) {
+        crc_ = CRC_INIT;
+        state_ = State::LENGTH;
+      }
+      break;
+    case State::LENGTH:
+      if (c > MAX_PAYLOAD) {
+        // Can't be a frame, hunt for the next sync.
+        reset();
+      } else {
+        length_ = c;
+        index_ = 0;
+        crc_ = crc_update(crc_, c);
+        state_ = State::TYPE;
+      }
+      break;
+    case State::TYPE:
+      type_ = c;
+      crc_ = crc_update(crc_, c);
+      state_ = (length_ == 0) ? State::CRC_LOW : State::PAYLOAD;
+      break;
+    case State::PAYLOAD:
+      payload_[index_++] = c;
+      crc_ = crc_update(crc_, c);
+      if (index_ == length_) state_ = State::CRC_LOW;
+      break;
+    case State::CRC_LOW:
+      received_crc_ = c;
+      state_ = State::CRC_HIGH;
+      break;
+    case State::CRC_HIGH:
+      received_crc_ |= static_cast<uint16_t>(c) << 8;
+      state_ = State::SYNC;
+      if (received_crc_ == crc_) return true;
+      ++crc_errors_;
+      break;
+  }
+  return false;
+}
@@ -1,50 +1,304 @@
 #include "io/framework.h"
 
+#include <cstring>
+
 #include "io/app_api.h"
+#include "pico/time.h"
 #include "tusb.h"
 
+#if TINY_EXPANDER_DUAL_CORE
+#include "hardware/sync.h"
+#include "io/spsc.h"
+#include "pico/flash.h"
+#include "pico/multicore.h"
+#endif
+
 Framework& Framework::get(const char* banner,
-                          const Console::Command* commands) {
+                          Console::Commands commands) {
   static auto framework = Framework{banner, commands};
   return framework;
 }
 
 #include "class/cdc/cdc_device.h"
 
+namespace {
+
+// Output written to a cdc fifo since it was last flushed.
+struct Pending {
+  uint32_t bytes;
+  uint64_t since;
+  // Input was read so the output that follows is its reply, flushed as soon
+  // as it's all written.
+  bool reply;
+};
+
+static Pending pending[CFG_TUD_CDC];
+
+constexpr auto policy(uint8_t channel) -> const Framework::Flush& {
+  return (channel == Framework::API_USB_CH) ? Framework::API_FLUSH
+                                            : Framework::DEBUG_FLUSH;
+}
+
+// Account for written bytes and flush if the policy says so, drained when
+// nothing more is waiting to be written.
+auto coalesce(uint8_t channel, size_t written, bool drained,
+              uint64_t now) -> void {
+  auto& state = pending[channel];
+  if (written != 0) {
+    if (state.bytes == 0) state.since = now;
+    state.bytes += written;
+  }
+  if (state.bytes == 0) return;
+  const auto& flush = policy(channel);
+  if ((state.reply && drained) || state.bytes >= flush.bytes ||
+      now - state.since >= flush.us) {
+    tud_cdc_n_write_flush(channel);
+    state.bytes = 0;
+    state.reply = false;
+  }
+}
+
+// When the oldest unflushed output is due out.
+auto flush_deadline() -> uint64_t {
+  auto deadline = Scheduler::NEVER;
+  for (uint8_t channel = 0; channel < CFG_TUD_CDC; ++channel) {
+    const auto& state = pending[channel];
+    if (state.bytes == 0) continue;
+    auto due = state.since + policy(channel).us;
+    if (due < deadline) deadline = due;
+  }
+  return deadline;
+}
+
+#if TINY_EXPANDER_DUAL_CORE
+
+// Byte rings between the USB core (1) and the application core (0).
+struct Link {
+  static constexpr size_t RX_SIZE = 256;
+  static constexpr size_t TX_SIZE = 1024;
+
+  Spsc<RX_SIZE> rx;
+  Spsc<TX_SIZE> tx;
+};
+
+static Link links[CFG_TUD_CDC];
+
+// Core 1 side, move bytes between a cdc channel and its link.
+auto transfer(uint8_t channel, Link& link, uint64_t now) -> bool {
+  bool moved = false;
+  auto [in, size] = link.rx.claim();
+  if (size) {
+    auto read = tud_cdc_n_read(channel, in, size);
+    link.rx.commit(read);
+    if (read != 0) {
+      pending[channel].reply = true;
+      moved = true;
+    }
+  }
+  // Two segments so a wrapped ring is drained in one pass.
+  size_t written = 0;
+  bool drained = true;
+  for (auto segment = 0; segment < 2; ++segment) {
+    auto [out, size] = link.tx.peek();
+    if (size == 0) break;
+    auto sent = tud_cdc_n_write(channel, out, size);
+    link.tx.consume(sent);
+    written += sent;
+    if (sent < size) {
+      drained = false;
+      break;
+    }
+  }
+  coalesce(channel, written, drained, now);
+  return moved || written != 0;
+}
+
+auto usb_core() -> void {
+  // Lets core 0 pause this core while it writes the store.
+  flash_safe_execute_core_init();
+  tusb_init();
+  for (;;) {
+    tud_task();
+    bool moved = false;
+    auto now = time_us_64();
+    for (uint8_t channel = 0; channel < CFG_TUD_CDC; ++channel) {
+      moved = transfer(channel, links[channel], now) || moved;
+    }
+    if (moved) {
+      // Wake core 0 to process the new data.
+      __sev();
+    } else if (!tud_task_event_ready()) {
+      // Woken by the USB interrupt, core 0 having queued output or held
+      // back output being due.
+      auto deadline = flush_deadline();
+      if (deadline == Scheduler::NEVER) {
+        __wfe();
+      } else {
+        best_effort_wfe_or_timeout(from_us_since_boot(deadline));
+      }
+    }
+  }
+}
+
+// Core 0 side, move bytes between a link and a console or app. True when
+// any bytes moved.
+template <typename Endpoint>
+auto service(uint8_t channel, Endpoint& endpoint, Stats& stats,
+             uint64_t) -> bool {
+  auto& link = links[channel];
+  bool queued = false;
+  size_t out_bytes = 0;
+  for (auto segment = 0; segment < 2; ++segment) {
+    auto [out, size] = endpoint.write_buffer();
+    if (size == 0) break;
+    auto [tx, room] = link.tx.claim();
+    if (room == 0) break;
+    auto length = (size < room) ? size : room;
+    memcpy(tx, out, length);
+    link.tx.commit(length);
+    endpoint.write_done(length);
+    out_bytes += length;
+    queued = true;
+  }
+  if (queued) __sev();
+  size_t in_bytes = 0;
+  auto [rx, available] = link.rx.peek();
+  if (available) {
+    auto [in, room] = endpoint.read_buffer();
+    in_bytes = (available < room) ? available : room;
+    memcpy(in, rx, in_bytes);
+    link.rx.consume(in_bytes);
+    endpoint.read_done(in_bytes);
+  }
+  stats.transfer(channel, in_bytes, out_bytes);
+  return in_bytes != 0 || out_bytes != 0;
+}
+
+template <typename Endpoint>
+auto has_work(uint8_t channel, Endpoint& endpoint) -> bool {
+  auto& link = links[channel];
+  if (!link.rx.empty()) return true;
+  return endpoint.write_buffer().second != 0 && link.tx.claim().second != 0;
+}
+
+#else
+
+// The last read filled the endpoint's buffer so more input may be waiting.
+static bool unread[CFG_TUD_CDC];
+
+// True when any bytes moved.
+template <typename Endpoint>
+auto service(uint8_t channel, Endpoint& endpoint, Stats& stats,
+             uint64_t now) -> bool {
+  // Two segments so a wrapped ring is drained in one pass.
+  size_t out_bytes = 0;
+  bool drained = true;
+  uint32_t room = 0;
+  for (auto segment = 0; segment < 2; ++segment) {
+    auto [out, size] = endpoint.write_buffer();
+    if (size == 0) break;
+    // Only asked for when there's something to write.
+    if (segment == 0) room = tud_cdc_n_write_available(channel);
+    auto sent = tud_cdc_n_write(channel, out, (size < room) ? size : room);
+    endpoint.write_done(sent);
+    out_bytes += sent;
+    room -= sent;
+    if (sent < size) {
+      drained = false;
+      break;
+    }
+  }
+  coalesce(channel, out_bytes, drained, now);
+  // Reading an empty fifo costs no more than asking if it's empty.
+  size_t in_bytes = 0;
+  auto [in, space] = endpoint.read_buffer();
+  if (space != 0) {
+    in_bytes = tud_cdc_n_read(channel, in, space);
+    unread[channel] = in_bytes == space;
+    if (in_bytes != 0) {
+      pending[channel].reply = true;
+      endpoint.read_done(in_bytes);
+    }
+  } else {
+    unread[channel] = tud_cdc_n_available(channel) != 0;
+  }
+  stats.transfer(channel, in_bytes, out_bytes);
+  return in_bytes != 0 || out_bytes != 0;
+}
+
+template <typename Endpoint>
+auto has_work(uint8_t channel, Endpoint& endpoint) -> bool {
+  // Input left over from this pass, anything newer comes with a usb event.
+  if (unread[channel]) return true;
+  // Output that could be sent now, otherwise the USB interrupt will wake us.
+  return endpoint.write_buffer().second != 0 &&
+         tud_cdc_n_write_available(channel);
+}
+
+#endif
+
+}  // namespace
+
 auto Framework::init() -> void {
+  // Before anything sets a baud rate from clk_peri.
+  power_.init(time_us_64());
+  scheduler_.init();
+  store_.init();
   if (app_) {
     app_->init();
   }
+#if TINY_EXPANDER_DUAL_CORE
+  multicore_launch_core1(usb_core);
+#else
   tusb_init();
+#endif
 }
 
 auto Framework::periodic() -> void {
+  auto now = time_us_64();
+  auto start = static_cast<uint32_t>(now);
+  auto mark = start;
+  auto lap = [this, &mark](Stats::Component component) {
+    auto now = time_us_32();
+    stats_.add(component, now - mark);
+    mark = now;
+  };
+#if !TINY_EXPANDER_DUAL_CORE
   tud_task();
+  lap(Stats::USB);
+#endif
   // Check for input over cdc debug channel.
-  if (tud_cdc_n_write_available(DEBUG_USB_CH)) {
-    auto [out, size] = console_.write_buffer();
-    auto sent = tud_cdc_n_write(DEBUG_USB_CH, out, size);
-    console_.write_done(sent);
-    tud_cdc_n_write_flush(DEBUG_USB_CH);
-  }
-  if (tud_cdc_n_available(DEBUG_USB_CH)) {
-    auto [in, size] = console_.read_buffer();
-    auto read = tud_cdc_n_read(DEBUG_USB_CH, in, size);
-    console_.read_done(read);
-  }
+  bool moved = service(DEBUG_USB_CH, console_, stats_, now);
+  lap(Stats::CONSOLE);
   // Check for input over cdc api channel.
   if (app_) {
-    if (tud_cdc_n_write_available(API_USB_CH)) {
-      auto [out, size] = app_->write_buffer();
-      auto sent = tud_cdc_n_write(API_USB_CH, out, size);
-      app_->write_done(sent);
-      tud_cdc_n_write_flush(API_USB_CH);
-    }
-    if (tud_cdc_n_available(API_USB_CH)) {
-      auto [in, size] = app_->read_buffer();
-      auto read = tud_cdc_n_read(API_USB_CH, in, size);
-      app_->read_done(read);
-    }
+    moved = service(API_USB_CH, *app_, stats_, now) || moved;
+    lap(Stats::API);
     app_->periodic();
+    lap(Stats::APP);
   }
+  auto& output = console_.output();
+  stats_.ring(DEBUG_USB_CH, output.high_water(), output.dropped());
+  stats_.pass(mark - start);
+  if (moved) power_.active(now);
+}
+
+auto Framework::wait() -> void {
+  if (busy()) return;
+  power_.idle(time_us_64());
+#if TINY_EXPANDER_DUAL_CORE
+  // Held back output is core 1's to send.
+  scheduler_.sleep();
+#else
+  scheduler_.sleep(flush_deadline());
+#endif
+}
+
+auto Framework::busy() -> bool {
+#if !TINY_EXPANDER_DUAL_CORE
+  // USB events waiting for tud_task().
+  if (tud_task_event_ready()) return true;
+#endif
+  if (has_work(DEBUG_USB_CH, console_)) return true;
+  return app_ && has_work(API_USB_CH, *app_);
 }
@@ -0,0 +1,39 @@
+#include "io/freq.h"
+
+namespace {
+
+static volatile uint32_t wraps[NUM_PWM_SLICES];
+static uint32_t slices = 0;
+
+}  // namespace
+
+auto FreqWraps::enable(uint slice) -> void {
+  if (slices == 0) {
+    irq_add_shared_handler(PWM_IRQ_WRAP, handler,
+                           PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(PWM_IRQ_WRAP, true);
+  }
+  slices |= 1u << slice;
+  pwm_clear_irq(slice);
+  pwm_set_irq_enabled(slice, true);
+}
+
+auto FreqWraps::count(uint slice) -> uint32_t {
+  auto counter = pwm_get_counter(slice);
+  uint32_t high = wraps[slice];
+  // A wrap not yet taken by handler(), only counts if the counter was read
+  // after it.
+  if ((pwm_get_irq_status_mask() & (1u << slice)) && counter < 0x8000) ++high;
+  return (high << 16) | counter;
+}
+
+auto FreqWraps::handler() -> void {
+  // Other slices may share the interrupt, only take ours.
+  auto status = pwm_get_irq_status_mask() & slices;
+  while (status) {
+    auto slice = __builtin_ctz(status);
+    status &= status - 1;
+    pwm_clear_irq(slice);
+    wraps[slice] = wraps[slice] + 1;
+  }
+}
@@ -0,0 +1,111 @@
+#include "io/link.h"
+
+#include <cstring>
+
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+
+namespace {
+
+// Kept below 2^28, on the RP2350 the top bits are the transfer mode.
+constexpr uint32_t RX_COUNT = 0x0fffffff;
+constexpr uint RX_RING_BITS = 8;
+static_assert((1u << RX_RING_BITS) == Link::RX_SIZE);
+
+// The DMA wraps its write address on a RX_SIZE boundary.
+alignas(Link::RX_SIZE) static uint8_t rx_ring[Link::RX_SIZE];
+static uint8_t tx_ring[Link::TX_SIZE];
+
+}  // namespace
+
+Link::Link()
+    : uart_{nullptr},
+      rx_channel_{0},
+      tx_channel_{0},
+      rx_done_{0},
+      rx_read_{0},
+      tx_head_{0},
+      tx_tail_{0},
+      tx_sending_{0},
+      overruns_{0} {}
+
+auto Link::init(uart_inst_t *uart, uint tx_pin, uint rx_pin,
+                uint baud) -> void {
+  if (uart_ != nullptr) return;
+  uart_ = uart;
+  uart_init(uart, baud);
+  gpio_set_function(tx_pin, GPIO_FUNC_UART);
+  gpio_set_function(rx_pin, GPIO_FUNC_UART);
+
+  rx_channel_ = static_cast<uint>(dma_claim_unused_channel(true));
+  auto rx = dma_channel_get_default_config(rx_channel_);
+  channel_config_set_transfer_data_size(&rx, DMA_SIZE_8);
+  channel_config_set_read_increment(&rx, false);
+  channel_config_set_write_increment(&rx, true);
+  channel_config_set_ring(&rx, true, RX_RING_BITS);
+  channel_config_set_dreq(&rx, uart_get_dreq(uart, false));
+  dma_channel_configure(rx_channel_, &rx, rx_ring, &uart_get_hw(uart)->dr,
+                        RX_COUNT, true);
+
+  tx_channel_ = static_cast<uint>(dma_claim_unused_channel(true));
+  auto tx = dma_channel_get_default_config(tx_channel_);
+  channel_config_set_transfer_data_size(&tx, DMA_SIZE_8);
+  channel_config_set_read_increment(&tx, true);
+  channel_config_set_write_increment(&tx, false);
+  channel_config_set_dreq(&tx, uart_get_dreq(uart, true));
+  dma_channel_configure(tx_channel_, &tx, &uart_get_hw(uart)->dr, tx_ring, 0,
+                        false);
+}
+
+auto Link::poll() -> void {
+  if (uart_ == nullptr) return;
+  if (!dma_channel_is_busy(rx_channel_)) {
+    // Carries on from where it stopped in the ring, the uart fifo holds
+    // anything arriving meanwhile.
+    rx_done_ += RX_COUNT;
+    dma_channel_set_trans_count(rx_channel_, RX_COUNT, true);
+  }
+  if (tx_sending_ != 0 && !dma_channel_is_busy(tx_channel_)) {
+    tx_tail_ += tx_sending_;
+    tx_sending_ = 0;
+  }
+  if (tx_sending_ == 0 && tx_head_ != tx_tail_) {
+    auto start = tx_tail_ % TX_SIZE;
+    auto run = tx_head_ - tx_tail_;
+    if (run > TX_SIZE - start) run = TX_SIZE - start;
+    tx_sending_ = run;
+    dma_channel_transfer_from_buffer_now(tx_channel_, &tx_ring[start], run);
+  }
+}
+
+auto Link::read_buffer() -> std::pair<const uint8_t *, size_t> {
+  if (uart_ == nullptr) return {rx_ring, 0};
+  auto available = received() - rx_read_;
+  if (available > RX_SIZE) {
+    // Lapped, what is there is a mix of old and new so skip it all.
+    ++overruns_;
+    rx_read_ += available;
+    available = 0;
+  }
+  auto start = rx_read_ % RX_SIZE;
+  if (available > RX_SIZE - start) available = RX_SIZE - start;
+  return {&rx_ring[start], available};
+}
+
+auto Link::read_done(size_t length) -> void { rx_read_ += length; }
+
+auto Link::write(const uint8_t *data, size_t length) -> bool {
+  if (uart_ == nullptr || length > room()) return false;
+  auto start = tx_head_ % TX_SIZE;
+  auto first = (length < TX_SIZE - start) ? length : TX_SIZE - start;
+  memcpy(&tx_ring[start], data, first);
+  memcpy(tx_ring, data + first, length - first);
+  tx_head_ += length;
+  poll();
+  return true;
+}
+
+auto Link::received() const -> uint32_t {
+  auto remaining = dma_channel_hw_addr(rx_channel_)->transfer_count & RX_COUNT;
+  return rx_done_ + (RX_COUNT - remaining);
+}
@@ -0,0 +1,39 @@
+#include "io/power.h"
+
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+
+Power::Power()
+    : slow_{false}, last_active_{0}, since_{0}, slow_us_{0}, wakes_{0} {}
+
+auto Power::init(uint64_t now) -> void {
+  last_active_ = now;
+  clock_configure(clk_peri, 0, CLOCKS_CLK_PERI_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB,
+                  USB_CLK_HZ, USB_CLK_HZ);
+  // Nothing uses the adc.
+  clock_stop(clk_adc);
+}
+
+auto Power::active(uint64_t now) -> void {
+  last_active_ = now;
+  if (!slow_) return;
+  pll_init(pll_sys, PLL_SYS_REFDIV, PLL_SYS_VCO_FREQ_HZ, PLL_SYS_POSTDIV1,
+           PLL_SYS_POSTDIV2);
+  clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                  CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_SYS, SYS_CLK_HZ,
+                  SYS_CLK_HZ);
+  slow_ = false;
+  slow_us_ += now - since_;
+  ++wakes_;
+}
+
+auto Power::idle(uint64_t now) -> void {
+  if (slow_ || now - last_active_ < IDLE_US) return;
+  // The aux mux is glitchless so this is safe with everything running.
+  clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+                  CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_HZ,
+                  USB_CLK_HZ);
+  pll_deinit(pll_sys);
+  slow_ = true;
+  since_ = now;
+}
@@ -0,0 +1,103 @@
+#include "io/scheduler.h"
+
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+
+namespace {
+
+// Nothing to do, taking the interrupt is enough to wake the core from __wfe().
+auto alarm_callback(uint) -> void {}
+
+}  // namespace
+
+Scheduler::Scheduler() : size_{0}, alarm_{-1} {
+  for (auto& position : position_) position = NONE;
+}
+
+auto Scheduler::init() -> void {
+  alarm_ = hardware_alarm_claim_unused(true);
+  hardware_alarm_set_callback(alarm_, alarm_callback);
+}
+
+auto Scheduler::schedule(Id id, uint64_t deadline) -> void {
+  if (deadline == 0) {
+    cancel(id);
+    return;
+  }
+  auto index = position_[id];
+  if (index == NONE) {
+    index = size_++;
+    place(index, Entry{deadline, id});
+    sift_up(index);
+  } else if (deadline < heap_[index].deadline) {
+    heap_[index].deadline = deadline;
+    sift_up(index);
+  } else {
+    heap_[index].deadline = deadline;
+    sift_down(index);
+  }
+}
+
+auto Scheduler::cancel(Id id) -> void {
+  auto index = position_[id];
+  if (index != NONE) remove(index);
+}
+
+auto Scheduler::pop(uint64_t now) -> Id {
+  if (size_ == 0 || heap_[0].deadline > now) return NONE;
+  auto id = heap_[0].id;
+  remove(0);
+  return id;
+}
+
+auto Scheduler::sleep(uint64_t until) -> void {
+  auto deadline = next_deadline();
+  if (until < deadline) deadline = until;
+  if (deadline != NEVER) {
+    // True if the deadline has already passed, so don't sleep.
+    if (hardware_alarm_set_target(alarm_, from_us_since_boot(deadline))) {
+      return;
+    }
+  }
+  __wfe();
+}
+
+auto Scheduler::remove(size_t index) -> void {
+  position_[heap_[index].id] = NONE;
+  --size_;
+  if (index == size_) return;
+  place(index, heap_[size_]);
+  // The moved entry only ever needs to go one way, the other is a no-op.
+  sift_up(index);
+  sift_down(index);
+}
+
+auto Scheduler::sift_up(size_t index) -> void {
+  auto entry = heap_[index];
+  while (index > 0) {
+    auto parent = (index - 1) / 2;
+    if (heap_[parent].deadline <= entry.deadline) break;
+    place(index, heap_[parent]);
+    index = parent;
+  }
+  place(index, entry);
+}
+
+auto Scheduler::sift_down(size_t index) -> void {
+  auto entry = heap_[index];
+  for (;;) {
+    auto child = (index * 2) + 1;
+    if (child >= size_) break;
+    if (child + 1 < size_ && heap_[child + 1].deadline < heap_[child].deadline)
+      ++child;
+    if (entry.deadline <= heap_[child].deadline) break;
+    place(index, heap_[child]);
+    index = child;
+  }
+  place(index, entry);
+}
+
+auto Scheduler::place(size_t index, const Entry& entry) -> void {
+  heap_[index] = entry;
+  position_[entry.id] = static_cast<Id>(index);
+}
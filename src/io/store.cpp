@@ -0,0 +1,191 @@
+#include "io/store.h"
+
+#include <cstring>
+
+#include "hardware/flash.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/watchdog.h"
+#include "pico/flash.h"
+
+namespace {
+
+constexpr uint32_t MAGIC = 0x564b5854;  // "TXKV"
+constexpr size_t SECTOR_SIZE = FLASH_SECTOR_SIZE;
+// Offset of the first of the two sectors from the start of flash.
+constexpr uint32_t STORE_OFFSET = PICO_FLASH_SIZE_BYTES - (2 * SECTOR_SIZE);
+constexpr uint32_t FLASH_TIMEOUT_MS = 100;
+
+// An erase when data is null, otherwise a program.
+struct Operation {
+  uint32_t offset;
+  const uint8_t *data;
+  size_t length;
+};
+
+auto run(void *param) -> void {
+  auto &operation = *static_cast<Operation *>(param);
+  if (operation.data == nullptr) {
+    flash_range_erase(operation.offset, operation.length);
+  } else {
+    flash_range_program(operation.offset, operation.data, operation.length);
+  }
+}
+
+// With the other core paused and interrupts off as XIP isn't available.
+// The watchdog is fed either side, a compaction's erase and programs
+// together can take longer than its timeout but no one of them does.
+auto execute(Operation operation) -> bool {
+  watchdog_update();
+  auto ok = flash_safe_execute(run, &operation, FLASH_TIMEOUT_MS) == PICO_OK;
+  watchdog_update();
+  return ok;
+}
+
+auto read(uint32_t offset) -> const uint8_t * {
+  return reinterpret_cast<const uint8_t *>(XIP_BASE + offset);
+}
+
+// Program bytes anywhere in the store. The rest of each page is programmed
+// with what it already holds, which leaves it unchanged.
+auto program(uint32_t offset, const uint8_t *data, size_t length) -> bool {
+  static uint8_t page[FLASH_PAGE_SIZE];
+  while (length != 0) {
+    auto base = offset & ~(FLASH_PAGE_SIZE - 1);
+    auto start = offset - base;
+    auto chunk = FLASH_PAGE_SIZE - start;
+    if (chunk > length) chunk = length;
+    memcpy(page, read(base), FLASH_PAGE_SIZE);
+    memcpy(&page[start], data, chunk);
+    if (!execute(Operation{base, page, FLASH_PAGE_SIZE})) return false;
+    offset += chunk;
+    data += chunk;
+    length -= chunk;
+  }
+  return true;
+}
+
+}  // namespace
+
+Store::Store() : index_{}, active_{1}, generation_{0}, end_{SECTOR_SIZE} {}
+
+auto Store::init() -> void {
+  Header headers[2];
+  for (uint8_t sector = 0; sector < 2; ++sector)
+    memcpy(&headers[sector], read(sector_address(sector)), sizeof(Header));
+  bool valid[2] = {headers[0].magic == MAGIC, headers[1].magic == MAGIC};
+  if (!valid[0] && !valid[1]) {
+    // Nothing stored, the first put() starts sector 0.
+    return;
+  }
+  uint8_t sector = valid[0] ? 0 : 1;
+  if (valid[0] && valid[1] &&
+      static_cast<int32_t>(headers[1].generation - headers[0].generation) > 0)
+    sector = 1;
+  active_ = sector;
+  generation_ = headers[sector].generation;
+  scan(sector);
+}
+
+auto Store::get(Key key, void *value, size_t length) const -> bool {
+  if (!contains(key)) return false;
+  auto record = read(sector_address(active_) + index_[key]);
+  if (record[offsetof(Record, length)] != length) return false;
+  memcpy(value, record + sizeof(Record), length);
+  return true;
+}
+
+auto Store::put(Key key, const void *value, size_t length) -> bool {
+  if (key >= MAX_KEYS || length > MAX_VALUE) return false;
+  if (length == 0 && !contains(key)) return true;
+  if (length != 0 && contains(key)) {
+    // Unchanged values aren't written again.
+    auto record = read(sector_address(active_) + index_[key]);
+    if (record[offsetof(Record, length)] == length &&
+        memcmp(record + sizeof(Record), value, length) == 0)
+      return true;
+  }
+  if (end_ + record_size(length) <= SECTOR_SIZE)
+    return append(key, value, length);
+  return compact(key, value, length);
+}
+
+auto Store::erase(Key key) -> bool { return put(key, nullptr, 0); }
+
+auto Store::sector_address(uint8_t sector) -> uint32_t {
+  return STORE_OFFSET + (sector * SECTOR_SIZE);
+}
+
+auto Store::check(const Record &record, const uint8_t *value) -> uint16_t {
+  // Fletcher style so a swapped or torn byte shows.
+  uint16_t sum = 0x5a + record.key;
+  uint16_t sums = sum;
+  sum += record.length;
+  sums += sum;
+  for (size_t i = 0; i < record.length; ++i) {
+    sum += value[i];
+    sums += sum;
+  }
+  return static_cast<uint16_t>((sums << 8) ^ sum);
+}
+
+auto Store::scan(uint8_t sector) -> void {
+  auto base = sector_address(sector);
+  size_t offset = sizeof(Header);
+  while (offset + sizeof(Record) <= SECTOR_SIZE) {
+    Record record;
+    memcpy(&record, read(base + offset), sizeof(record));
+    if (record.key == 0xff) break;
+    auto size = record_size(record.length);
+    auto value = read(base + offset + sizeof(Record));
+    if (record.key >= MAX_KEYS || record.length > MAX_VALUE ||
+        offset + size > SECTOR_SIZE || check(record, value) != record.check) {
+      // Torn write, nothing more can be appended after it.
+      offset = SECTOR_SIZE;
+      break;
+    }
+    index_[record.key] = (record.length == 0) ? 0 : offset;
+    offset += size;
+  }
+  end_ = offset;
+}
+
+auto Store::append(Key key, const void *value, size_t length) -> bool {
+  uint8_t data[sizeof(Record) + MAX_VALUE + 3] = {};
+  auto record = Record{key, static_cast<uint8_t>(length), 0};
+  if (length != 0) memcpy(&data[sizeof(Record)], value, length);
+  record.check = check(record, &data[sizeof(Record)]);
+  memcpy(data, &record, sizeof(record));
+  auto size = record_size(length);
+  if (!program(sector_address(active_) + end_, data, size)) return false;
+  index_[key] = (length == 0) ? 0 : end_;
+  end_ += size;
+  return true;
+}
+
+// Copy the live values, with key's new value, to the other sector.
+auto Store::compact(Key key, const void *value, size_t length) -> bool {
+  uint8_t sector = active_ ^ 1;
+  auto from = sector_address(active_);
+  auto to = sector_address(sector);
+  if (!execute(Operation{to, nullptr, SECTOR_SIZE})) return false;
+  uint16_t index[MAX_KEYS] = {};
+  size_t offset = sizeof(Header);
+  for (Key k = 0; k < MAX_KEYS; ++k) {
+    if (k == key || index_[k] == 0) continue;
+    auto record = read(from + index_[k]);
+    auto size = record_size(record[offsetof(Record, length)]);
+    if (!program(to + offset, record, size)) return false;
+    index[k] = offset;
+    offset += size;
+  }
+  memcpy(index_, index, sizeof(index_));
+  active_ = sector;
+  end_ = offset;
+  if (length != 0 && !append(key, value, length)) return false;
+  // The header last so a reset part way leaves the old sector in use.
+  auto header = Header{MAGIC, generation_ + 1};
+  if (!program(to, reinterpret_cast<const uint8_t *>(&header), sizeof(header)))
+    return false;
+  generation_ = header.generation;
+  return true;
+}
@@ -1,30 +1,93 @@
+#if !TINY_EXPANDER_LEAN
 #include <stdio.h>
+#endif
 
 #include "app/app.h"
 #include "io/framework.h"
 
 namespace {
 
+static App* application = nullptr;
+
 static auto help(Console& console, Console::CommandLine& tokens) -> void {
   console.printf("Tiny extender help:\r\n");
   console.printf("    help    - This help.\r\n");
+  console.printf("    config [<key> <value>] - Show or set settings.\r\n");
+  console.printf("    stats [reset] - Main loop counters.\r\n");
+}
+
+static auto stats(Console& console, Console::CommandLine& tokens) -> void {
+  auto& stats = Framework::get().stats();
+  if (tokens.number == 2) {
+    stats.reset();
+    return;
+  }
+  console.printf("Passes: %u min: %uus max: %uus\r\n", stats.passes(),
+                 stats.min_us(), stats.max_us());
+  for (size_t bucket = 0; bucket < Stats::NUM_BUCKETS; ++bucket) {
+    if (stats.histogram(bucket) != 0)
+      console.printf("    <%6uus: %u\r\n", 1u << bucket,
+                     stats.histogram(bucket));
+  }
+  const char* names[] = {"usb", "console", "api", "app"};
+  for (uint8_t component = 0; component < Stats::NUM_COMPONENTS; ++component) {
+    console.printf("    %-8s %llums\r\n", names[component],
+                   stats.time_us(static_cast<Stats::Component>(component)) /
+                       1000);
+  }
+  const char* channels[] = {"api", "console"};
+  for (uint8_t channel = 0; channel < Stats::NUM_CHANNELS; ++channel) {
+    auto& counts = stats.channel(channel);
+    console.printf("    %-8s in: %u out: %u high water: %u dropped: %u\r\n",
+                   channels[channel], counts.in, counts.out,
+                   counts.high_water, counts.dropped);
+  }
+  auto& power = Framework::get().power();
+  console.printf("Power: slowed %llums woken: %u%s\r\n",
+                 power.slow_us(time_us_64()) / 1000, power.wakes(),
+                 power.slow() ? " (slow)" : "");
+}
+
+static auto config(Console& console, Console::CommandLine& tokens) -> void {
+  if (tokens.number == 3) {
+    uint32_t key = 0;
+    uint32_t value = 0;
+    if (!tokens.parameters[1].to_unsigned(key) || key > 0xff ||
+        !tokens.parameters[2].to_unsigned(value) ||
+        !application->configure(static_cast<uint8_t>(key), value)) {
+      console.printf("Bad setting\r\n");
+    }
+    return;
+  }
+  for (unsigned key = 0; key <= 0xff; ++key) {
+    uint32_t value = 0;
+    if (application->setting(static_cast<uint8_t>(key), value))
+      console.printf("    %3u: %u\r\n", key, value);
+  }
 }
 
-Console::Command commands[] = {{"help", help}, {nullptr, nullptr}};
+constexpr Console::Command command_list[] = {
+    {"help", help}, {"config", config}, {"stats", stats}};
+constexpr auto commands = Console::sorted(command_list);
+static_assert(Console::unique(commands), "Duplicate console command");
 const char* banner = "\r\n\r\nUSB Tiny extender\r\n";
 
 }  // namespace
 
 int main() {
-  auto& framework = Framework::get(banner, commands);
+  auto& framework = Framework::get(banner, Console::table(commands));
   static auto app = App{framework};
+  application = &app;
   framework.app(&app);
   framework.init();
 
+#if !TINY_EXPANDER_LEAN
   puts(banner);
+#endif
 
   for (;;) {
     framework.periodic();
+    framework.wait();
   }
   return 0;
 }